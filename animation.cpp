@@ -0,0 +1,153 @@
+#include "animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATION_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+#ifdef ANIMATION_SSE
+inline __m128 load(const glm::vec4 &v) { return _mm_loadu_ps(&v.x); }
+
+// dot product of a and b in every lane
+inline __m128 dot4(__m128 a, __m128 b) {
+  __m128 m = _mm_mul_ps(a, b);
+  m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+#endif
+
+// key at or before time and the blend factor towards the next one
+size_t findKey(const vector<float> &times, float time, float &factor) {
+  factor = 0.f;
+  auto it = upper_bound(times.begin(), times.end(), time);
+  if (it == times.begin())
+    return 0;
+  size_t key = it - times.begin() - 1;
+  if (key + 1 < times.size()) {
+    float span = times[key + 1] - times[key];
+    if (span > 0.f)
+      factor = (time - times[key]) / span;
+  }
+  return key;
+}
+
+glm::vec4 sampleLinear(const vector<float> &times,
+                       const vector<glm::vec4> &values, float time,
+                       const glm::vec4 &fallback) {
+  if (values.empty())
+    return fallback;
+  float f;
+  size_t key = findKey(times, time, f);
+  const glm::vec4 &a = values[key];
+  const glm::vec4 &b = values[min(key + 1, values.size() - 1)];
+#ifdef ANIMATION_SSE
+  glm::vec4 result;
+  __m128 va = load(a);
+  _mm_storeu_ps(&result.x, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(load(b), va),
+                                                     _mm_set1_ps(f))));
+  return result;
+#else
+  return a + (b - a) * f;
+#endif
+}
+
+// normalized lerp along the shorter arc. Keys are close enough together for
+// it to pass for slerp.
+glm::vec4 sampleRotation(const vector<float> &times,
+                         const vector<glm::vec4> &values, float time) {
+  if (values.empty())
+    return glm::vec4(0.f, 0.f, 0.f, 1.f);
+  float f;
+  size_t key = findKey(times, time, f);
+  const glm::vec4 &a = values[key];
+  const glm::vec4 &b = values[min(key + 1, values.size() - 1)];
+#ifdef ANIMATION_SSE
+  glm::vec4 result;
+  __m128 va = load(a), vb = load(b);
+  // flips b onto a's hemisphere by copying the sign of the dot product
+  __m128 sign = _mm_and_ps(dot4(va, vb),
+                           _mm_castsi128_ps(_mm_set1_epi32(0x80000000)));
+  vb = _mm_xor_ps(vb, sign);
+  __m128 q = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), _mm_set1_ps(f)));
+  _mm_storeu_ps(&result.x, _mm_div_ps(q, _mm_sqrt_ps(dot4(q, q))));
+  return result;
+#else
+  glm::vec4 q = a + ((glm::dot(a, b) < 0.f ? -b : b) - a) * f;
+  return q / glm::length(q);
+#endif
+}
+
+glm::mat4 compose(const glm::vec4 &t, const glm::vec4 &q, const glm::vec4 &s) {
+  float x = q.x, y = q.y, z = q.z, w = q.w;
+  glm::mat4 m;
+  m[0] = glm::vec4(1.f - 2.f * (y * y + z * z), 2.f * (x * y + w * z),
+                   2.f * (x * z - w * y), 0.f) *
+         s.x;
+  m[1] = glm::vec4(2.f * (x * y - w * z), 1.f - 2.f * (x * x + z * z),
+                   2.f * (y * z + w * x), 0.f) *
+         s.y;
+  m[2] = glm::vec4(2.f * (x * z + w * y), 2.f * (y * z - w * x),
+                   1.f - 2.f * (x * x + y * y), 0.f) *
+         s.z;
+  m[3] = glm::vec4(t.x, t.y, t.z, 1.f);
+  return m;
+}
+
+// out = a * b, out may be either of them
+void multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out) {
+#ifdef ANIMATION_SSE
+  __m128 a0 = load(a[0]), a1 = load(a[1]), a2 = load(a[2]), a3 = load(a[3]);
+  for (int c = 0; c < 4; c++) {
+    __m128 column = load(b[c]);
+    __m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(column, column, 0x00));
+    r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(column, column, 0x55)));
+    r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(column, column, 0xAA)));
+    r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(column, column, 0xFF)));
+    _mm_storeu_ps(&out[c].x, r);
+  }
+#else
+  out = a * b;
+#endif
+}
+} // namespace
+
+void evaluatePose(const Skeleton &skeleton, const AnimationClip *clip,
+                  float time, glm::mat4 *palette) {
+  // scratch per thread, poses are evaluated on the worker pool
+  thread_local vector<glm::mat4> locals, globals;
+  size_t nodeCount = skeleton.nodes.size();
+  locals.resize(nodeCount);
+  globals.resize(nodeCount);
+  for (size_t i = 0; i < nodeCount; i++)
+    locals[i] = skeleton.nodes[i].bindLocal;
+
+  if (clip) {
+    if (clip->duration > 0.f) {
+      time = fmod(time, clip->duration);
+      if (time < 0.f)
+        time += clip->duration;
+    }
+    for (auto &track : clip->tracks)
+      locals[track.node] = compose(
+          sampleLinear(track.positionTimes, track.positions, time,
+                       glm::vec4(0.f)),
+          sampleRotation(track.rotationTimes, track.rotations, time),
+          sampleLinear(track.scaleTimes, track.scales, time, glm::vec4(1.f)));
+  }
+
+  // parents come first, so one pass resolves the hierarchy. The global
+  // inverse goes in at the roots instead of into every joint matrix.
+  for (size_t i = 0; i < nodeCount; i++) {
+    int parent = skeleton.nodes[i].parent;
+    multiply(parent < 0 ? skeleton.globalInverse : globals[parent], locals[i],
+             globals[i]);
+  }
+  for (size_t j = 0; j < skeleton.joints.size(); j++)
+    multiply(globals[skeleton.joints[j].node], skeleton.joints[j].offset,
+             palette[j]);
+}
@@ -0,0 +1,58 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// node of a model's scene hierarchy. Parents come before their children.
+struct SkeletonNode {
+  string name;
+  int parent; // -1 for the root
+  glm::mat4 bindLocal; // relative to the parent when no clip moves it
+};
+
+// what a skinned vertex's joint index refers to: a node and the matrix that
+// takes mesh space into that node's space in the bind pose
+struct Joint {
+  unsigned int node;
+  glm::mat4 offset;
+};
+
+// keyframes of one node. Times are in seconds; positions and scales have
+// w = 0, rotations are x, y, z, w quaternions. Kept as vec4 so the sampler
+// loads every key with one unaligned SIMD load.
+struct AnimationTrack {
+  unsigned int node;
+  vector<float> positionTimes, rotationTimes, scaleTimes;
+  vector<glm::vec4> positions, rotations, scales;
+};
+
+struct AnimationClip {
+  string name;
+  float duration = 0.f; // seconds
+  vector<AnimationTrack> tracks;
+};
+
+// Joints and animations of a model. Empty for static models.
+struct Skeleton {
+  vector<SkeletonNode> nodes;
+  vector<Joint> joints; // MAX_SKIN_JOINTS at most
+  vector<AnimationClip> clips;
+  // undoes the root node's transform, so skinned meshes end up in the same
+  // space as the static ones, which are drawn without node transforms
+  glm::mat4 globalInverse = glm::mat4(1.f);
+
+  bool empty() const { return joints.empty(); }
+};
+
+// Samples clip (looping) at time and writes one skinning matrix per joint
+// to palette. Without a clip the skeleton is posed in its bind pose. Uses
+// SSE where available for key interpolation and the matrix products. Safe
+// to call from several threads at once.
+void evaluatePose(const Skeleton &skeleton, const AnimationClip *clip,
+                  float time, glm::mat4 *palette);
+
+#endif
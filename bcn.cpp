@@ -0,0 +1,191 @@
+#include "bcn.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+namespace {
+uint16_t to565(const float color[3]) {
+  auto quantize = [](float value, int levels) {
+    return min(max(int(value * levels / 255.f + 0.5f), 0), levels);
+  };
+  return uint16_t(quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 |
+                  quantize(color[2], 31));
+}
+
+void from565(uint16_t c, float color[3]) {
+  int r = c >> 11 & 31, g = c >> 5 & 63, b = c & 31;
+  color[0] = float(r << 3 | r >> 2);
+  color[1] = float(g << 2 | g >> 4);
+  color[2] = float(b << 3 | b >> 2);
+}
+
+// weight of the first endpoint for each index of a four colour block
+const float ENDPOINT_WEIGHT[4] = {1.f, 0.f, 2.f / 3.f, 1.f / 3.f};
+
+// picks the nearest palette entry for every texel, returns the squared error
+float fitIndices(const uint8_t rgba[64], uint16_t c0, uint16_t c1,
+                 uint32_t &indices) {
+  float palette[4][3];
+  from565(c0, palette[0]);
+  from565(c1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+    palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+  }
+  indices = 0;
+  float total = 0.f;
+  for (int i = 0; i < 16; i++) {
+    float best = 1e30f;
+    uint32_t bestIndex = 0;
+    for (uint32_t k = 0; k < 4; k++) {
+      float error = 0.f;
+      for (int c = 0; c < 3; c++) {
+        float d = rgba[i * 4 + c] - palette[k][c];
+        error += d * d;
+      }
+      if (error < best) {
+        best = error;
+        bestIndex = k;
+      }
+    }
+    indices |= bestIndex << (i * 2);
+    total += best;
+  }
+  return total;
+}
+
+// endpoints of a four colour block need c0 > c1
+bool order(uint16_t &c0, uint16_t &c1) {
+  if (c0 < c1)
+    swap(c0, c1);
+  return c0 != c1;
+}
+
+void encodeColor(const uint8_t rgba[64], uint8_t out[8]) {
+  float mean[3] = {};
+  for (int i = 0; i < 16; i++)
+    for (int c = 0; c < 3; c++)
+      mean[c] += rgba[i * 4 + c] / 16.f;
+  float cov[6] = {}; // xx xy xz yy yz zz
+  for (int i = 0; i < 16; i++) {
+    float d[3];
+    for (int c = 0; c < 3; c++)
+      d[c] = rgba[i * 4 + c] - mean[c];
+    cov[0] += d[0] * d[0];
+    cov[1] += d[0] * d[1];
+    cov[2] += d[0] * d[2];
+    cov[3] += d[1] * d[1];
+    cov[4] += d[1] * d[2];
+    cov[5] += d[2] * d[2];
+  }
+  // principal axis by power iteration
+  float axis[3] = {1.f, 1.f, 1.f};
+  for (int iteration = 0; iteration < 8; iteration++) {
+    float v[3] = {cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                  cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                  cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+    float scale = max(max(fabs(v[0]), fabs(v[1])), fabs(v[2]));
+    if (scale < 1e-6f)
+      break;
+    for (int c = 0; c < 3; c++)
+      axis[c] = v[c] / scale;
+  }
+  float length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+  float lo = 0.f, hi = 0.f;
+  for (int i = 0; i < 16; i++) {
+    float t = 0.f;
+    for (int c = 0; c < 3; c++)
+      t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+    lo = min(lo, t / length2);
+    hi = max(hi, t / length2);
+  }
+  float e0[3], e1[3];
+  for (int c = 0; c < 3; c++) {
+    e0[c] = mean[c] + axis[c] * hi;
+    e1[c] = mean[c] + axis[c] * lo;
+  }
+
+  uint16_t c0 = to565(e0), c1 = to565(e1);
+  uint32_t indices = 0;
+  if (order(c0, c1)) {
+    float error = fitIndices(rgba, c0, c1, indices);
+    // solve for the endpoints that best fit the chosen indices
+    float aa = 0.f, ab = 0.f, bb = 0.f, ax[3] = {}, bx[3] = {};
+    for (int i = 0; i < 16; i++) {
+      float a = ENDPOINT_WEIGHT[indices >> (i * 2) & 3], b = 1.f - a;
+      aa += a * a;
+      ab += a * b;
+      bb += b * b;
+      for (int c = 0; c < 3; c++) {
+        ax[c] += a * rgba[i * 4 + c];
+        bx[c] += b * rgba[i * 4 + c];
+      }
+    }
+    float det = aa * bb - ab * ab;
+    if (fabs(det) > 1e-6f) {
+      for (int c = 0; c < 3; c++) {
+        e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+        e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+      }
+      uint16_t r0 = to565(e0), r1 = to565(e1);
+      uint32_t refined;
+      if (order(r0, r1) && fitIndices(rgba, r0, r1, refined) < error) {
+        c0 = r0;
+        c1 = r1;
+        indices = refined;
+      }
+    }
+  }
+  // equal endpoints are the three colour mode, where index 0 is still c0
+  out[0] = uint8_t(c0);
+  out[1] = uint8_t(c0 >> 8);
+  out[2] = uint8_t(c1);
+  out[3] = uint8_t(c1 >> 8);
+  memcpy(out + 4, &indices, 4);
+}
+} // namespace
+
+void encodeBC1Block(const uint8_t rgba[64], uint8_t out[8]) {
+  encodeColor(rgba, out);
+}
+
+void encodeBC3Block(const uint8_t rgba[64], uint8_t out[16]) {
+  encodeBC4Block(rgba + 3, 4, out);
+  encodeColor(rgba, out + 8);
+}
+
+void encodeBC4Block(const uint8_t *values, int stride, uint8_t out[8]) {
+  uint8_t lo = 255, hi = 0;
+  for (int i = 0; i < 16; i++) {
+    lo = min(lo, values[i * stride]);
+    hi = max(hi, values[i * stride]);
+  }
+  // hi > lo selects the eight value ramp; equal ends need index 0 only
+  out[0] = hi;
+  out[1] = lo;
+  uint64_t bits = 0;
+  if (hi > lo) {
+    int palette[8] = {hi, lo};
+    for (int k = 2; k < 8; k++)
+      palette[k] = ((8 - k) * hi + (k - 1) * lo + 3) / 7;
+    for (int i = 0; i < 16; i++) {
+      int value = values[i * stride], best = 256;
+      uint64_t bestIndex = 0;
+      for (int k = 0; k < 8; k++)
+        if (abs(value - palette[k]) < best) {
+          best = abs(value - palette[k]);
+          bestIndex = k;
+        }
+      bits |= bestIndex << (i * 3);
+    }
+  }
+  for (int i = 0; i < 6; i++)
+    out[2 + i] = uint8_t(bits >> (i * 8));
+}
+
+void encodeBC5Block(const uint8_t rgba[64], uint8_t out[16]) {
+  encodeBC4Block(rgba, 4, out);
+  encodeBC4Block(rgba + 1, 4, out + 8);
+}
@@ -0,0 +1,19 @@
+#ifndef BCN_H
+#define BCN_H
+
+#include <cstdint>
+
+// CPU encoders for the BCn block formats. Every call encodes one 4x4 block
+// given as 16 texels row by row; rgba blocks have 4 bytes per texel.
+
+// opaque colour: endpoints along the principal axis of the block, refined
+// once by least squares. Alpha is ignored.
+void encodeBC1Block(const uint8_t rgba[64], uint8_t out[8]);
+// a BC4 block for alpha followed by a BC1 colour block
+void encodeBC3Block(const uint8_t rgba[64], uint8_t out[16]);
+// one channel, values[i * stride] for texel i
+void encodeBC4Block(const uint8_t *values, int stride, uint8_t out[8]);
+// red and green as two BC4 blocks, for normal maps
+void encodeBC5Block(const uint8_t rgba[64], uint8_t out[16]);
+
+#endif
@@ -0,0 +1,285 @@
+#include "benchmark.h"
+#include "objloader.h"
+#include "image_decode.h"
+#include "stb_image.h"
+#include "threadpool.h"
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+using namespace std;
+
+namespace {
+struct BenchMesh {
+  unsigned int VAO, VBO, EBO;
+  unsigned int indexCount;
+};
+
+// uploads the given meshes in one layout
+vector<BenchMesh> uploadMeshes(const vector<Mesh *> &meshes,
+                               VertexFormat format, size_t &vertexBytes) {
+  vector<BenchMesh> result;
+  vertexBytes = 0;
+  for (Mesh *mesh : meshes) {
+    BenchMesh bench;
+    glGenVertexArrays(1, &bench.VAO);
+    glGenBuffers(1, &bench.VBO);
+    glGenBuffers(1, &bench.EBO);
+    glBindVertexArray(bench.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, bench.VBO);
+    if (format == VERTEX_COMPACT) {
+      vector<CompactVertex> compact;
+      packCompactVertices(mesh->vertices, compact);
+      vertexBytes += compact.size() * sizeof(CompactVertex);
+      glBufferData(GL_ARRAY_BUFFER, compact.size() * sizeof(CompactVertex),
+                   compact.data(), GL_STATIC_DRAW);
+    } else {
+      vertexBytes += mesh->vertices.size() * sizeof(Vertex);
+      glBufferData(GL_ARRAY_BUFFER, mesh->vertices.size() * sizeof(Vertex),
+                   mesh->vertices.data(), GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bench.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 mesh->indices.size() * sizeof(unsigned int),
+                 mesh->indices.data(), GL_STATIC_DRAW);
+    setupVertexAttributes(format);
+    bench.indexCount = mesh->indices.size();
+    result.push_back(bench);
+  }
+  glBindVertexArray(0);
+  return result;
+}
+
+void freeMeshes(vector<BenchMesh> &meshes) {
+  for (auto &bench : meshes) {
+    glDeleteVertexArrays(1, &bench.VAO);
+    glDeleteBuffers(1, &bench.VBO);
+    glDeleteBuffers(1, &bench.EBO);
+  }
+  meshes.clear();
+}
+
+// GPU milliseconds for drawing all meshes `iterations` times
+double timePass(Shader &shader, const vector<BenchMesh> &meshes,
+                int iterations) {
+  shader.use();
+  auto drawAll = [&] {
+    for (auto &bench : meshes) {
+      glBindVertexArray(bench.VAO);
+      glDrawElements(GL_TRIANGLES, bench.indexCount, GL_UNSIGNED_INT, 0);
+    }
+  };
+  drawAll(); // warm up caches and lazy driver state
+
+  unsigned int query;
+  glGenQueries(1, &query);
+  glBeginQuery(GL_TIME_ELAPSED, query);
+  for (int i = 0; i < iterations; i++)
+    drawAll();
+  glEndQuery(GL_TIME_ELAPSED);
+  GLuint64 nanoseconds = 0;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+  glDeleteQueries(1, &query);
+  return nanoseconds / 1e6;
+}
+} // namespace
+
+string benchmarkVertexFormats(Model &model, int iterations) {
+  static Shader gBufferShader("gBufferShader.vs", "gBufferShader.fs");
+  static Shader depthShader("simpleDepthShader.vs", "simpleDepthShader.fs");
+  glm::mat4 identity(1.f);
+  gBufferShader.use();
+  gBufferShader.setMat4("model", identity);
+  gBufferShader.setMat4("view", identity);
+  gBufferShader.setMat4("projection", identity);
+  depthShader.use();
+  depthShader.setMat4("model", identity);
+  depthShader.setMat4("lightSpaceMatrix", identity);
+
+  // only meshes both layouts can hold, so both runs do the same work. Meshes
+  // that dropped their CPU vertices (GEOMETRY_KEEP not set) can't be
+  // uploaded again and are skipped.
+  vector<Mesh *> meshes;
+  size_t triangles = 0;
+  for (auto &mesh : model.meshes) {
+    vector<CompactVertex> compact;
+    if (!mesh.vertices.empty() && packCompactVertices(mesh.vertices, compact)) {
+      meshes.push_back(&mesh);
+      triangles += mesh.indices.size() / 3;
+    }
+  }
+
+  // without rasterization only vertex fetch and shading are left to measure
+  glEnable(GL_RASTERIZER_DISCARD);
+  double gBufferMs[2], depthMs[2];
+  size_t vertexBytes[2];
+  VertexFormat formats[2] = {VERTEX_FULL, VERTEX_COMPACT};
+  for (int f = 0; f < 2; f++) {
+    vector<BenchMesh> uploaded =
+        uploadMeshes(meshes, formats[f], vertexBytes[f]);
+    glFinish();
+    gBufferMs[f] = timePass(gBufferShader, uploaded, iterations);
+    depthMs[f] = timePass(depthShader, uploaded, iterations);
+    freeMeshes(uploaded);
+  }
+  glDisable(GL_RASTERIZER_DISCARD);
+  glBindVertexArray(0);
+
+  char report[512];
+  snprintf(report, sizeof(report),
+           "%s: %zu/%zu meshes, %zu triangles x %d\n"
+           "  full    (%2zu B): %6.1f MB, G-buffer %7.2f ms, depth %7.2f ms\n"
+           "  compact (%2zu B): %6.1f MB, G-buffer %7.2f ms, depth %7.2f ms\n"
+           "  speedup: G-buffer %.2fx, depth %.2fx",
+           model.directory.c_str(), meshes.size(), model.meshes.size(),
+           triangles, iterations, sizeof(Vertex), vertexBytes[0] / 1048576.0,
+           gBufferMs[0], depthMs[0], sizeof(CompactVertex),
+           vertexBytes[1] / 1048576.0, gBufferMs[1], depthMs[1],
+           gBufferMs[0] / max(gBufferMs[1], 1e-6),
+           depthMs[0] / max(depthMs[1], 1e-6));
+  cout << "Vertex format benchmark, " << report << endl;
+  return report;
+}
+
+string benchmarkObjImport(const string &path, bool flipUVs, int iterations) {
+  // the flags Model::readModel imports with
+  unsigned int importFlags = aiProcess_Triangulate |
+                             aiProcess_JoinIdenticalVertices |
+                             aiProcess_CalcTangentSpace |
+                             (flipUVs ? aiProcess_FlipUVs : 0);
+  double assimpMs = 1e30, builtinMs = 1e30;
+  size_t counts[2][3] = {}; // meshes, vertices, triangles
+  for (int i = 0; i < iterations; i++) {
+    auto start = chrono::steady_clock::now();
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(path, importFlags);
+    assimpMs = min(assimpMs, elapsedMs(start, chrono::steady_clock::now()));
+    if (!scene)
+      return "Assimp can't read " + path;
+    counts[0][0] = scene->mNumMeshes;
+    counts[0][1] = counts[0][2] = 0;
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+      counts[0][1] += scene->mMeshes[m]->mNumVertices;
+      counts[0][2] += scene->mMeshes[m]->mNumFaces;
+    }
+
+    start = chrono::steady_clock::now();
+    vector<MeshData> meshes;
+    map<unsigned int, vector<Texture>> materials;
+    if (!readObj(path, flipUVs, meshes, materials))
+      return "Can't read " + path;
+    builtinMs = min(builtinMs, elapsedMs(start, chrono::steady_clock::now()));
+    counts[1][0] = meshes.size();
+    counts[1][1] = counts[1][2] = 0;
+    for (auto &mesh : meshes) {
+      counts[1][1] += mesh.vertices.size();
+      counts[1][2] += mesh.indices.size() / 3;
+    }
+  }
+
+  char report[512];
+  snprintf(report, sizeof(report),
+           "%s: best of %d\n"
+           "  assimp:   %8.1f ms, %zu meshes, %zu vertices, %zu triangles\n"
+           "  built-in: %8.1f ms, %zu meshes, %zu vertices, %zu triangles\n"
+           "  speedup: %.2fx",
+           path.c_str(), iterations, assimpMs, counts[0][0], counts[0][1],
+           counts[0][2], builtinMs, counts[1][0], counts[1][1], counts[1][2],
+           assimpMs / max(builtinMs, 1e-6));
+  cout << "OBJ import benchmark, " << report << endl;
+  return report;
+}
+
+string benchmarkImageDecode(const vector<string> &directories,
+                            int iterations) {
+  vector<string> paths;
+  for (auto &directory : directories) {
+    std::error_code ec;
+    for (auto it = filesystem::recursive_directory_iterator(directory, ec);
+         !ec && it != filesystem::recursive_directory_iterator();
+         it.increment(ec)) {
+      string extension = it->path().extension().string();
+      for (char &c : extension)
+        c = char(tolower((unsigned char)c));
+      if (extension == ".tga" || extension == ".png" || extension == ".jpg" ||
+          extension == ".jpeg")
+        paths.push_back(it->path().generic_string());
+    }
+  }
+  // files stb can't read (git LFS pointers, say) don't count
+  vector<string> images;
+  double megapixels = 0.0;
+  for (auto &path : paths) {
+    int width, height, channels;
+    if (stbi_info(path.c_str(), &width, &height, &channels)) {
+      images.push_back(path);
+      megapixels += width * double(height) / 1e6;
+    }
+  }
+  if (images.empty())
+    return "No readable images found";
+
+  double stbMs = 1e30, serialMs = 1e30, parallelMs = 1e30;
+  for (int i = 0; i < iterations; i++) {
+    auto start = chrono::steady_clock::now();
+    for (auto &path : images) {
+      int width, height, channels;
+      stbi_image_free(stbi_load(path.c_str(), &width, &height, &channels, 4));
+    }
+    stbMs = min(stbMs, elapsedMs(start, chrono::steady_clock::now()));
+
+    start = chrono::steady_clock::now();
+    for (auto &path : images) {
+      DecodedImage image;
+      decodeImage(path, image);
+    }
+    serialMs = min(serialMs, elapsedMs(start, chrono::steady_clock::now()));
+
+    start = chrono::steady_clock::now();
+    getWorkerPool().parallelFor(images.size(), [&](size_t i) {
+      DecodedImage image;
+      decodeImage(images[i], image);
+    });
+    parallelMs =
+        min(parallelMs, elapsedMs(start, chrono::steady_clock::now()));
+  }
+
+  // the expansion alone, on a 4096x4096 image
+  const size_t texels = 4096 * 4096;
+  vector<unsigned char> rgb(texels * 3), rgba(texels * 4);
+  for (size_t i = 0; i < rgb.size(); i++)
+    rgb[i] = (unsigned char)(i * 7);
+  double scalarMs = 1e30, simdMs = 1e30;
+  for (int i = 0; i < iterations; i++) {
+    auto start = chrono::steady_clock::now();
+    for (size_t t = 0; t < texels; t++) {
+      rgba[t * 4] = rgb[t * 3];
+      rgba[t * 4 + 1] = rgb[t * 3 + 1];
+      rgba[t * 4 + 2] = rgb[t * 3 + 2];
+      rgba[t * 4 + 3] = 255;
+    }
+    scalarMs = min(scalarMs, elapsedMs(start, chrono::steady_clock::now()));
+    start = chrono::steady_clock::now();
+    expandToRGBA(rgb.data(), rgba.data(), texels);
+    simdMs = min(simdMs, elapsedMs(start, chrono::steady_clock::now()));
+  }
+  double kernelMegapixels = texels / 1e6;
+
+  char report[640];
+  snprintf(report, sizeof(report),
+           "%zu images, %.1f MP, best of %d\n"
+           "  stb_image to RGBA:    %8.1f ms, %7.1f MP/s\n"
+           "  decodeImage serial:   %8.1f ms, %7.1f MP/s\n"
+           "  decodeImage parallel: %8.1f ms, %7.1f MP/s (%u workers)\n"
+           "  RGB to RGBA: scalar %.0f MP/s, kernel %.0f MP/s",
+           images.size(), megapixels, iterations, stbMs,
+           megapixels / stbMs * 1e3, serialMs, megapixels / serialMs * 1e3,
+           parallelMs, megapixels / parallelMs * 1e3,
+           getWorkerPool().size(), kernelMegapixels / scalarMs * 1e3,
+           kernelMegapixels / simdMs * 1e3);
+  cout << "Image decode benchmark, " << report << endl;
+  return report;
+}
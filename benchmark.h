@@ -0,0 +1,27 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "model.h"
+
+#include <string>
+using namespace std;
+
+// Draws the model's meshes many times with rasterization discarded, once per
+// vertex layout, and times the G-buffer and shadow vertex stages on the GPU.
+// Returns a printable report.
+string benchmarkVertexFormats(Model &model, int iterations = 20);
+
+// Reads an OBJ file with Assimp (the flags Model uses) and with the built-in
+// reader, the best of a few runs each, without meshes processing or caches.
+// Returns a printable report.
+string benchmarkObjImport(const string &path, bool flipUVs = true,
+                          int iterations = 3);
+
+// Decodes every image under the directories with plain stb_image (to RGBA,
+// one after the other), with decodeImage one after the other and with
+// decodeImage on the worker pool, and times the RGB to RGBA kernel against
+// a scalar loop. Returns a printable report in megapixels per second.
+string benchmarkImageDecode(const vector<string> &directories,
+                            int iterations = 3);
+
+#endif
@@ -26,5 +26,65 @@
 #define RANDOM_TEXTURE_W 128
 #define RANDOM_TEXTURE_H 128
 
+#define MESH_CACHE_ENABLED true
+#define MESH_CACHE_EXTENSION ".meshcache"
+// store cached vertices/indices through the lossless codec in vertexcodec.h
+#define MESH_CACHE_COMPRESSION true
+// reorder triangles and vertices for the post-transform cache at import
+#define MESH_OPTIMIZE_ENABLED true
+// simplified levels generated per mesh, each with about half the triangles
+#define MESH_LOD_LEVELS 3
+// largest simplification error, relative to the mesh's bounding radius
+#define MESH_LOD_MAX_ERROR 0.05f
+// meshes smaller than this are not simplified
+#define MESH_LOD_MIN_TRIANGLES 128
+// projected diameter (pixels) below which LOD 1 is used; halves per level
+#define LOD_SCREEN_SIZE 400.f
+// relative band around each switch size where the current LOD is kept
+#define LOD_HYSTERESIS 0.15f
+// triangle and vertex limits of the clusters full detail meshes are split in
+#define MESHLET_MAX_TRIANGLES 124
+#define MESHLET_MAX_VERTICES 64
+// drop clusters outside the view frustum in the G-buffer pass
+#define MESHLET_CULLING_ENABLED true
+// also drop clusters facing away from the camera. Off by default: face
+// culling is off in this engine and open, single-sided surfaces show their
+// back, which cone culling would hide
+#define MESHLET_CONE_CULLING false
+
+// merge the meshes of a model that bind the same textures at load time
+#define MESH_BATCHING_ENABLED true
+
+// VERTEX_COMPACT or VERTEX_FULL, see mesh.h
+#define DEFAULT_VERTEX_FORMAT VERTEX_COMPACT
+// CPU geometry meshes keep once uploaded: GEOMETRY_KEEP, GEOMETRY_POSITIONS
+// or GEOMETRY_DROP, see mesh.h
+#define DEFAULT_GEOMETRY_RESIDENCY GEOMETRY_DROP
+
+#define ASYNC_TEXTURE_LOADING true
+#define TEXTURE_UPLOAD_BUDGET_MB 16
+// textures and their mip chains are built once into a cache file next to
+// the source; block compress them (BC1/BC3/BC4/BC5) on the way
+#define TEXTURE_COMPRESSION true
+#define TEXTURE_CACHE_EXTENSION ".dds"
+// pack same-sized material textures of a model into texture arrays. Arrays
+// need every level resident, so they are only used without streaming.
+#define TEXTURE_ARRAYS_ENABLED true
+// keep only the mip levels of model textures their size on screen needs,
+// within a VRAM budget (texture_streamer.h)
+#define TEXTURE_STREAMING true
+#define TEXTURE_STREAMING_BUDGET_MB 256
+// levels up to this size stay resident whatever the budget
+#define TEXTURE_STREAMING_MIN_SIZE 64
+#define TEXTURE_STREAMING_MAX_LOADS 8
+
+// import models on the worker pool and create their meshes across frames
+#define ASYNC_MODEL_LOADING true
+#define MODEL_UPLOAD_BUDGET_MB 32
+// load .gltf/.glb with the native loader (gltf.h) instead of Assimp
+#define NATIVE_GLTF_LOADER true
+// load .obj with the built-in parallel reader (objloader.h) instead of Assimp
+#define BUILTIN_OBJ_LOADER true
+
 
 #endif
\ No newline at end of file
@@ -5,15 +5,36 @@ class DebugData {
 public:
   int triangles = 0;
   int indices = 0;
+  int lodSavedTriangles = 0; // skipped by drawing a simplified level
+  int clusterCulledTriangles = 0; // in meshlets culled before drawing
+  int drawCalls = 0;
+  int unbatchedDrawCalls = 0; // the same draws without mesh batching
+  int textureBinds = 0;
+  int unpackedTextureBinds = 0; // binding every material texture per draw
 
   void addTriangles(int num) {
     triangles += num;
     indices += num * 3;
   }
 
+  void addLodSavedTriangles(int num) { lodSavedTriangles += num; }
+  void addClusterCulledTriangles(int num) { clusterCulledTriangles += num; }
+  void addTextureBinds(int num) { textureBinds += num; }
+  void addUnpackedTextureBinds(int num) { unpackedTextureBinds += num; }
+  void addDrawCalls(int num, int unbatched) {
+    drawCalls += num;
+    unbatchedDrawCalls += unbatched;
+  }
+
   void clear() {
     triangles = 0;
     indices = 0;
+    lodSavedTriangles = 0;
+    clusterCulledTriangles = 0;
+    drawCalls = 0;
+    unbatchedDrawCalls = 0;
+    textureBinds = 0;
+    unpackedTextureBinds = 0;
   }
 
 private:
@@ -0,0 +1,241 @@
+#include "geometry_arena.h"
+
+#include <algorithm>
+#include <iostream>
+using namespace std;
+
+GeometryArena::GeometryArena(VertexFormat format)
+    : format(format),
+      stride(format == VERTEX_COMPACT ? sizeof(CompactVertex)
+                                      : sizeof(Vertex)) {
+  glGenVertexArrays(1, &vao);
+  // whole vertices only, so an offset always converts to a base vertex
+  vertexHeap.granularity = stride;
+  indexHeap.granularity = 4;
+  skinHeap.granularity = sizeof(SkinVertex);
+  size_t initial = size_t(GEOMETRY_ARENA_INITIAL_MB) << 20;
+  vertexHeap.resize(initial / stride * stride);
+  indexHeap.resize(initial);
+  attachBuffers();
+}
+
+void GeometryArena::attachBuffers() {
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexHeap.buffer);
+  setupVertexAttributes(format);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexHeap.buffer);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+unsigned int GeometryArena::allocate(const void *vertices, size_t vertexCount,
+                                     const void *indices, size_t indexCount,
+                                     GLenum indexType,
+                                     const SkinVertex *skin) {
+  Range range;
+  range.vertexBytes = vertexCount * stride;
+  range.skinBytes = skin ? vertexCount * sizeof(SkinVertex) : 0;
+  // 16-bit index arrays are padded so every range starts 4-byte aligned
+  range.indexBytes = (indexCount * indexTypeSize(indexType) + 3) & ~size_t(3);
+  range.indexCount = indexCount;
+  range.indexType = indexType;
+  range.live = true;
+
+  size_t vertexCapacity = vertexHeap.capacity,
+         indexCapacity = indexHeap.capacity;
+  range.vertexOffset = vertexHeap.allocate(range.vertexBytes);
+  range.indexOffset = indexHeap.allocate(range.indexBytes);
+  // the skin buffer isn't attached to the VAO, bind() picks up a new one
+  if (skin && !skinHeap.buffer) {
+    size_t initial = size_t(GEOMETRY_ARENA_INITIAL_MB) << 20;
+    skinHeap.resize(initial / 4 / sizeof(SkinVertex) * sizeof(SkinVertex));
+  }
+  range.skinOffset = skinHeap.allocate(range.skinBytes);
+  if (vertexHeap.capacity != vertexCapacity ||
+      indexHeap.capacity != indexCapacity)
+    attachBuffers();
+
+  // upload through the copy target, binding GL_ELEMENT_ARRAY_BUFFER here
+  // would change whichever VAO happens to be bound
+  glBindBuffer(GL_COPY_WRITE_BUFFER, vertexHeap.buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, range.vertexOffset, range.vertexBytes,
+                  vertices);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, indexHeap.buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, range.indexOffset,
+                  indexCount * indexTypeSize(indexType), indices);
+  if (skin) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, skinHeap.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range.skinOffset, range.skinBytes,
+                    skin);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  if (!freeHandles.empty()) {
+    unsigned int handle = freeHandles.back();
+    freeHandles.pop_back();
+    ranges[handle] = range;
+    return handle;
+  }
+  ranges.push_back(range);
+  return ranges.size() - 1;
+}
+
+void GeometryArena::free(unsigned int handle) {
+  Range &range = ranges[handle];
+  if (!range.live) {
+    cout << "::Warning:: Freeing geometry that is not allocated: " << handle
+         << endl;
+    return;
+  }
+  vertexHeap.release(range.vertexOffset, range.vertexBytes);
+  indexHeap.release(range.indexOffset, range.indexBytes);
+  skinHeap.release(range.skinOffset, range.skinBytes);
+  range.live = false;
+  freeHandles.push_back(handle);
+
+  size_t initial = size_t(GEOMETRY_ARENA_INITIAL_MB) << 20;
+  if (capacityBytes() > 2 * initial && usedBytes() * 2 < capacityBytes())
+    compact();
+}
+
+void GeometryArena::drawRanges(unsigned int handle,
+                               const unsigned int *firstIndices,
+                               const GLsizei *counts,
+                               size_t rangeCount) const {
+  const Range &range = ranges[handle];
+  size_t indexSize = indexTypeSize(range.indexType);
+  drawOffsets.resize(rangeCount);
+  drawBaseVertices.assign(rangeCount, GLint(range.vertexOffset / stride));
+  for (size_t i = 0; i < rangeCount; i++)
+    drawOffsets[i] =
+        (const void *)(range.indexOffset + firstIndices[i] * indexSize);
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, range.indexType,
+                                drawOffsets.data(), GLsizei(rangeCount),
+                                drawBaseVertices.data());
+}
+
+void GeometryArena::compact() {
+  vector<pair<size_t *, size_t>> vertexBlocks, indexBlocks, skinBlocks;
+  for (auto &range : ranges) {
+    if (!range.live)
+      continue;
+    vertexBlocks.push_back({&range.vertexOffset, range.vertexBytes});
+    indexBlocks.push_back({&range.indexOffset, range.indexBytes});
+    if (range.skinBytes)
+      skinBlocks.push_back({&range.skinOffset, range.skinBytes});
+  }
+  size_t before = capacityBytes();
+  vertexHeap.compact(vertexBlocks);
+  indexHeap.compact(indexBlocks);
+  if (skinHeap.buffer)
+    skinHeap.compact(skinBlocks);
+  attachBuffers();
+  cout << "Geometry arena compacted: " << before / 1048576.0 << " MB -> "
+       << capacityBytes() / 1048576.0 << " MB" << endl;
+}
+
+size_t GeometryArena::BufferHeap::allocate(size_t size) {
+  if (size == 0)
+    return 0;
+  for (size_t i = 0; i < holes.size(); i++) {
+    if (holes[i].second < size)
+      continue;
+    size_t offset = holes[i].first;
+    holes[i].first += size;
+    holes[i].second -= size;
+    if (holes[i].second == 0)
+      holes.erase(holes.begin() + i);
+    used += size;
+    return offset;
+  }
+  // no hole is big enough: double the buffer, which grows or appends the
+  // hole at the end
+  size_t newCapacity = max(capacity, granularity);
+  size_t tail = !holes.empty() && holes.back().first + holes.back().second ==
+                                      capacity
+                    ? holes.back().second
+                    : 0;
+  while (newCapacity - capacity + tail < size)
+    newCapacity *= 2;
+  resize(newCapacity);
+  return allocate(size);
+}
+
+void GeometryArena::BufferHeap::release(size_t offset, size_t size) {
+  if (size == 0)
+    return;
+  used -= size;
+  auto it = lower_bound(holes.begin(), holes.end(), make_pair(offset, size));
+  it = holes.insert(it, {offset, size});
+  // merge with the following and the preceding hole
+  if (it + 1 != holes.end() && it->first + it->second == (it + 1)->first) {
+    it->second += (it + 1)->second;
+    holes.erase(it + 1);
+  }
+  if (it != holes.begin() && (it - 1)->first + (it - 1)->second == it->first) {
+    (it - 1)->second += it->second;
+    holes.erase(it);
+  }
+}
+
+void GeometryArena::BufferHeap::resize(size_t newCapacity) {
+  unsigned int newBuffer;
+  glGenBuffers(1, &newBuffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, NULL, GL_STATIC_DRAW);
+  if (buffer) {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        capacity);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  if (!holes.empty() && holes.back().first + holes.back().second == capacity)
+    holes.back().second += newCapacity - capacity;
+  else
+    holes.push_back({capacity, newCapacity - capacity});
+  buffer = newBuffer;
+  capacity = newCapacity;
+}
+
+void GeometryArena::BufferHeap::compact(
+    vector<pair<size_t *, size_t>> &blocks) {
+  sort(blocks.begin(), blocks.end(),
+       [](auto &a, auto &b) { return *a.first < *b.first; });
+  // keep some room so the next load doesn't immediately grow it again
+  size_t newCapacity = max<size_t>(used + used / 4, 1 << 16);
+  newCapacity = (newCapacity + granularity - 1) / granularity * granularity;
+
+  unsigned int newBuffer;
+  glGenBuffers(1, &newBuffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, NULL, GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+  size_t offset = 0;
+  for (auto &block : blocks) {
+    if (block.second)
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                          *block.first, offset, block.second);
+    *block.first = offset;
+    offset += block.second;
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  glDeleteBuffers(1, &buffer);
+
+  buffer = newBuffer;
+  capacity = newCapacity;
+  holes.clear();
+  if (offset < capacity)
+    holes.push_back({offset, capacity - offset});
+}
+
+GeometryArena &getGeometryArena(VertexFormat format) {
+  // never destroyed: the GL context is gone by the time statics are
+  static GeometryArena *arenas[2] = {};
+  if (!arenas[format])
+    arenas[format] = new GeometryArena(format);
+  return *arenas[format];
+}
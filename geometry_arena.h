@@ -0,0 +1,121 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include "vertex.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// initial size of each arena buffer, they double when full
+#define GEOMETRY_ARENA_INITIAL_MB 8
+
+// Sub-allocates the geometry of all meshes that share a vertex format from
+// one vertex buffer and one index buffer behind a single VAO, so drawing a
+// model only binds a VAO once. Meshes refer to their geometry by handle; the
+// offsets behind a handle change when the arena grows or is compacted.
+// Skinned meshes also get a range in a third buffer holding their skin
+// stream, created on first use and bound as a storage buffer with the VAO.
+class GeometryArena {
+public:
+  struct Range {
+    size_t vertexOffset = 0; // bytes
+    size_t vertexBytes = 0;
+    size_t indexOffset = 0; // bytes
+    size_t indexBytes = 0;
+    size_t skinOffset = 0; // bytes
+    size_t skinBytes = 0;  // 0 for static meshes
+    unsigned int indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    bool live = false;
+  };
+
+  explicit GeometryArena(VertexFormat format);
+
+  // copies the vertices (laid out for this arena's format), indices and, for
+  // skinned meshes, one SkinVertex per vertex into the arena and returns the
+  // handle to draw them with
+  unsigned int allocate(const void *vertices, size_t vertexCount,
+                        const void *indices, size_t indexCount,
+                        GLenum indexType, const SkinVertex *skin = nullptr);
+  // frees the geometry of a handle. Compacts the arena once more than half of
+  // it is holes.
+  void free(unsigned int handle);
+  // moves all live geometry to the front of new, tightly sized buffers
+  void compact();
+
+  void bind() const {
+    glBindVertexArray(vao);
+    if (skinHeap.buffer)
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SKIN_STREAM_BINDING,
+                       skinHeap.buffer);
+  }
+  // draws a handle, the arena has to be bound
+  void draw(unsigned int handle) const {
+    draw(handle, 0, ranges[handle].indexCount);
+  }
+  // draws part of a handle's indices
+  void draw(unsigned int handle, unsigned int firstIndex,
+            unsigned int indexCount) const {
+    const Range &range = ranges[handle];
+    glDrawElementsBaseVertex(
+        GL_TRIANGLES, indexCount, range.indexType,
+        (void *)(range.indexOffset + firstIndex * indexTypeSize(range.indexType)),
+        GLint(range.vertexOffset / stride));
+  }
+  // draws several index ranges of a handle with one glMultiDrawElements call
+  void drawRanges(unsigned int handle, const unsigned int *firstIndices,
+                  const GLsizei *counts, size_t rangeCount) const;
+  const Range &range(unsigned int handle) const { return ranges[handle]; }
+  // what the vertex shader adds to gl_VertexID (which includes the base
+  // vertex) to find a skinned handle's vertex in the skin stream
+  int skinBase(unsigned int handle) const {
+    const Range &range = ranges[handle];
+    return int(range.skinOffset / sizeof(SkinVertex)) -
+           int(range.vertexOffset / stride);
+  }
+
+  VertexFormat getFormat() const { return format; }
+  size_t usedBytes() const {
+    return vertexHeap.used + indexHeap.used + skinHeap.used;
+  }
+  size_t capacityBytes() const {
+    return vertexHeap.capacity + indexHeap.capacity + skinHeap.capacity;
+  }
+
+private:
+  // first-fit allocator over one GL buffer
+  struct BufferHeap {
+    unsigned int buffer = 0;
+    size_t capacity = 0, used = 0;
+    size_t granularity = 1; // every offset and size is a multiple of it
+    vector<pair<size_t, size_t>> holes; // offset, size; sorted by offset
+
+    size_t allocate(size_t size);
+    void release(size_t offset, size_t size);
+    void resize(size_t newCapacity);
+    // copies the given blocks to the front of a new buffer, updating offsets
+    void compact(vector<pair<size_t *, size_t>> &blocks);
+  };
+
+  VertexFormat format;
+  size_t stride;
+  unsigned int vao = 0;
+  BufferHeap vertexHeap, indexHeap, skinHeap;
+  vector<Range> ranges;
+  vector<unsigned int> freeHandles;
+  // per-range arguments of drawRanges, kept to avoid allocating per draw
+  mutable vector<const void *> drawOffsets;
+  mutable vector<GLint> drawBaseVertices;
+
+  // points the VAO at the current buffers after they were replaced
+  void attachBuffers();
+};
+
+// one arena per vertex format, created on first use
+GeometryArena &getGeometryArena(VertexFormat format);
+
+#endif
@@ -0,0 +1,619 @@
+#include "gltf.h"
+#include "debug.h"
+#include "mapped_file.h"
+#include "texture_registry.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cctype>
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+using namespace std;
+
+namespace {
+// just enough of a JSON DOM for glTF. Missing members and out of range
+// elements read as null.
+struct Json {
+  enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+  Type type = NUL;
+  double number = 0.0;
+  string text;
+  vector<Json> items; // array elements, or object values
+  vector<string> keys; // object keys, parallel to items
+
+  const Json &operator[](const char *key) const {
+    for (size_t i = 0; i < keys.size(); i++)
+      if (keys[i] == key)
+        return items[i];
+    return null();
+  }
+  const Json &operator[](size_t index) const {
+    return type == ARRAY && index < items.size() ? items[index] : null();
+  }
+  size_t size() const { return type == ARRAY ? items.size() : 0; }
+  bool isNull() const { return type == NUL; }
+  double num(double fallback = 0.0) const {
+    return type == NUMBER ? number : fallback;
+  }
+  int index() const { return type == NUMBER ? int(number) : -1; }
+  bool boolean() const { return type == BOOLEAN && number != 0.0; }
+
+  static const Json &null() {
+    static const Json none;
+    return none;
+  }
+};
+
+class JsonParser {
+public:
+  explicit JsonParser(const string &text)
+      : p(text.c_str()), end(text.c_str() + text.size()) {}
+
+  bool parse(Json &out) {
+    if (!value(out, 0))
+      return false;
+    skipSpace();
+    return p == end;
+  }
+
+private:
+  const char *p, *end;
+
+  void skipSpace() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+      p++;
+  }
+  bool literal(const char *word) {
+    size_t length = strlen(word);
+    if (size_t(end - p) < length || strncmp(p, word, length) != 0)
+      return false;
+    p += length;
+    return true;
+  }
+
+  bool value(Json &out, int depth) {
+    if (depth > 64)
+      return false;
+    skipSpace();
+    if (p == end)
+      return false;
+    switch (*p) {
+    case '{': {
+      out.type = Json::OBJECT;
+      p++;
+      skipSpace();
+      if (p < end && *p == '}') {
+        p++;
+        return true;
+      }
+      while (true) {
+        string key;
+        skipSpace();
+        if (!str(key))
+          return false;
+        skipSpace();
+        if (p == end || *p++ != ':')
+          return false;
+        out.keys.push_back(std::move(key));
+        out.items.emplace_back();
+        if (!value(out.items.back(), depth + 1))
+          return false;
+        skipSpace();
+        if (p < end && *p == ',') {
+          p++;
+          continue;
+        }
+        return p < end && *p++ == '}';
+      }
+    }
+    case '[': {
+      out.type = Json::ARRAY;
+      p++;
+      skipSpace();
+      if (p < end && *p == ']') {
+        p++;
+        return true;
+      }
+      while (true) {
+        out.items.emplace_back();
+        if (!value(out.items.back(), depth + 1))
+          return false;
+        skipSpace();
+        if (p < end && *p == ',') {
+          p++;
+          continue;
+        }
+        return p < end && *p++ == ']';
+      }
+    }
+    case '"':
+      out.type = Json::STRING;
+      return str(out.text);
+    case 't':
+      out.type = Json::BOOLEAN;
+      out.number = 1.0;
+      return literal("true");
+    case 'f':
+      out.type = Json::BOOLEAN;
+      return literal("false");
+    case 'n':
+      return literal("null");
+    default: {
+      // the text is null terminated, strtod can't run past it
+      char *after;
+      out.type = Json::NUMBER;
+      out.number = strtod(p, &after);
+      if (after == p)
+        return false;
+      p = after;
+      return true;
+    }
+    }
+  }
+
+  static void appendUtf8(string &out, uint32_t c) {
+    if (c < 0x80)
+      out += char(c);
+    else if (c < 0x800) {
+      out += char(0xC0 | (c >> 6));
+      out += char(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+      out += char(0xE0 | (c >> 12));
+      out += char(0x80 | ((c >> 6) & 0x3F));
+      out += char(0x80 | (c & 0x3F));
+    } else {
+      out += char(0xF0 | (c >> 18));
+      out += char(0x80 | ((c >> 12) & 0x3F));
+      out += char(0x80 | ((c >> 6) & 0x3F));
+      out += char(0x80 | (c & 0x3F));
+    }
+  }
+  bool hex4(uint32_t &c) {
+    if (end - p < 4)
+      return false;
+    c = 0;
+    for (int i = 0; i < 4; i++, p++) {
+      char h = *p;
+      c <<= 4;
+      if (h >= '0' && h <= '9')
+        c |= h - '0';
+      else if (h >= 'a' && h <= 'f')
+        c |= h - 'a' + 10;
+      else if (h >= 'A' && h <= 'F')
+        c |= h - 'A' + 10;
+      else
+        return false;
+    }
+    return true;
+  }
+  bool str(string &out) {
+    if (p == end || *p != '"')
+      return false;
+    p++;
+    while (p < end && *p != '"') {
+      if (*p != '\\') {
+        out += *p++;
+        continue;
+      }
+      if (++p == end)
+        return false;
+      char escape = *p++;
+      switch (escape) {
+      case 'b': out += '\b'; break;
+      case 'f': out += '\f'; break;
+      case 'n': out += '\n'; break;
+      case 'r': out += '\r'; break;
+      case 't': out += '\t'; break;
+      case 'u': {
+        uint32_t c;
+        if (!hex4(c))
+          return false;
+        // surrogate pair
+        if (c >= 0xD800 && c < 0xDC00 && end - p >= 6 && p[0] == '\\' &&
+            p[1] == 'u') {
+          p += 2;
+          uint32_t low;
+          if (!hex4(low))
+            return false;
+          c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        }
+        appendUtf8(out, c);
+        break;
+      }
+      default: out += escape; break;
+      }
+    }
+    if (p == end)
+      return false;
+    p++;
+    return true;
+  }
+};
+
+// resolves %XX escapes of a relative URI
+string decodeUri(const string &uri) {
+  string out;
+  for (size_t i = 0; i < uri.size(); i++) {
+    if (uri[i] == '%' && i + 2 < uri.size()) {
+      out += char(strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+      i += 2;
+    } else
+      out += uri[i];
+  }
+  return out;
+}
+
+struct Accessor {
+  int view = -1;
+  size_t offset = 0; // bytes into the view
+  GLenum componentType = GL_FLOAT;
+  unsigned int count = 0;
+  int components = 1;
+  bool normalized = false;
+};
+
+bool readAccessor(const Json &doc, int index, Accessor &out) {
+  const Json &accessor = doc["accessors"][size_t(index)];
+  if (index < 0 || accessor.isNull() || !accessor["sparse"].isNull())
+    return false;
+  out.view = accessor["bufferView"].index();
+  out.offset = size_t(accessor["byteOffset"].num());
+  out.componentType = GLenum(accessor["componentType"].num(GL_FLOAT));
+  out.count = unsigned(accessor["count"].num());
+  out.normalized = accessor["normalized"].boolean();
+  const string &type = accessor["type"].text;
+  out.components = type == "VEC2"   ? 2
+                   : type == "VEC3" ? 3
+                   : type == "VEC4" ? 4
+                   : type == "MAT4" ? 16
+                                    : 1;
+  return out.view >= 0;
+}
+
+glm::mat4 nodeTransform(const Json &node) {
+  const Json &matrix = node["matrix"];
+  if (matrix.size() == 16) {
+    // column major, like glm
+    glm::mat4 m;
+    for (int i = 0; i < 16; i++)
+      m[i / 4][i % 4] = float(matrix[size_t(i)].num());
+    return m;
+  }
+  const Json &t = node["translation"], &r = node["rotation"],
+             &s = node["scale"];
+  glm::mat4 m(1.f);
+  if (t.size() == 3)
+    m = glm::translate(m, glm::vec3(t[0].num(), t[1].num(), t[2].num()));
+  if (r.size() == 4)
+    m *= glm::mat4_cast(glm::quat(float(r[3].num()), float(r[0].num()),
+                                  float(r[1].num()), float(r[2].num())));
+  if (s.size() == 3)
+    m = glm::scale(m, glm::vec3(s[0].num(1.0), s[1].num(1.0), s[2].num(1.0)));
+  return m;
+}
+
+const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+const uint32_t GLB_JSON = 0x4E4F534A;
+const uint32_t GLB_BIN = 0x004E4942;
+} // namespace
+
+bool GltfScene::handles(const string &path) {
+  size_t dot = path.find_last_of('.');
+  if (dot == string::npos)
+    return false;
+  string extension = path.substr(dot + 1);
+  for (auto &c : extension)
+    c = char(tolower(c));
+  return extension == "gltf" || extension == "glb";
+}
+
+GltfScene::~GltfScene() { release(); }
+
+void GltfScene::release() {
+  for (auto &primitive : primitives)
+    glDeleteVertexArrays(1, &primitive.vao);
+  primitives.clear();
+  draws.clear();
+  if (buffer)
+    glDeleteBuffers(1, &buffer);
+  buffer = 0;
+  bufferBytes = 0;
+  for (unsigned int id : textures)
+    textureRegistry.release(id);
+  textures.clear();
+}
+
+bool GltfScene::load(const string &path) {
+  directory = path.substr(0, path.find_last_of('/'));
+  MappedFile file;
+  if (!file.open(path)) {
+    cout << "ERROR::GLTF:: Can't open " << path << endl;
+    return false;
+  }
+
+  // a GLB is a JSON chunk followed by an optional binary chunk that stands
+  // in for the first buffer
+  string text;
+  const unsigned char *glbData = nullptr;
+  size_t glbSize = 0;
+  uint32_t header[3] = {};
+  if (file.size() >= 12)
+    memcpy(header, file.data(), 12);
+  if (header[0] == GLB_MAGIC) {
+    size_t offset = 12, length = min<size_t>(header[2], file.size());
+    while (offset + 8 <= length) {
+      uint32_t chunk[2];
+      memcpy(chunk, file.data() + offset, 8);
+      offset += 8;
+      if (chunk[0] > length - offset)
+        break;
+      if (chunk[1] == GLB_JSON && text.empty())
+        text.assign((const char *)file.data() + offset, chunk[0]);
+      else if (chunk[1] == GLB_BIN && !glbData) {
+        glbData = file.data() + offset;
+        glbSize = chunk[0];
+      }
+      offset += (chunk[0] + 3) & ~size_t(3);
+    }
+  } else
+    text.assign((const char *)file.data(), file.size());
+
+  Json doc;
+  if (!JsonParser(text).parse(doc)) {
+    cout << "ERROR::GLTF:: Invalid JSON in " << path << endl;
+    return false;
+  }
+  if (doc["skins"].size()) {
+    cout << "::Warning:: glTF skins need the Assimp path: " << path << endl;
+    return false;
+  }
+
+  // map the buffers; they only have to live until the upload is done
+  vector<unique_ptr<MappedFile>> files;
+  vector<pair<const unsigned char *, size_t>> buffers;
+  const Json &bufferList = doc["buffers"];
+  for (size_t i = 0; i < bufferList.size(); i++) {
+    const string &uri = bufferList[i]["uri"].text;
+    if (uri.empty() && i == 0 && glbData) {
+      buffers.push_back({glbData, glbSize});
+      continue;
+    }
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0) {
+      cout << "ERROR::GLTF:: Embedded buffers are not supported: " << path
+           << endl;
+      return false;
+    }
+    files.push_back(make_unique<MappedFile>());
+    string bufferPath = directory + '/' + decodeUri(uri);
+    if (!files.back()->open(bufferPath)) {
+      cout << "ERROR::GLTF:: Can't open buffer " << bufferPath << endl;
+      return false;
+    }
+    buffers.push_back({files.back()->data(), files.back()->size()});
+  }
+
+  // the attributes the shaders read, by location
+  static const pair<const char *, GLuint> ATTRIBUTES[] = {
+      {"POSITION", 0}, {"NORMAL", 1}, {"TEXCOORD_0", 2}, {"TANGENT", 3}};
+
+  // lay out every buffer view a primitive reads in one GL buffer. Offsets
+  // stay 16-byte aligned, which keeps every accessor's alignment.
+  const Json &views = doc["bufferViews"];
+  const Json &meshes = doc["meshes"];
+  map<int, size_t> viewOffsets;
+  auto useAccessor = [&](int index) {
+    Accessor accessor;
+    if (!readAccessor(doc, index, accessor))
+      return;
+    const Json &view = views[size_t(accessor.view)];
+    int source = view["buffer"].index();
+    size_t begin = size_t(view["byteOffset"].num()),
+           length = size_t(view["byteLength"].num());
+    if (source < 0 || size_t(source) >= buffers.size() ||
+        begin + length > buffers[source].second)
+      return;
+    if (!viewOffsets.count(accessor.view)) {
+      viewOffsets[accessor.view] = bufferBytes;
+      bufferBytes += (length + 15) & ~size_t(15);
+    }
+  };
+  for (size_t m = 0; m < meshes.size(); m++)
+    for (size_t p = 0; p < meshes[m]["primitives"].size(); p++) {
+      const Json &primitive = meshes[m]["primitives"][p];
+      for (auto &attribute : ATTRIBUTES)
+        useAccessor(primitive["attributes"][attribute.first].index());
+      useAccessor(primitive["indices"].index());
+    }
+  if (!bufferBytes) {
+    cout << "ERROR::GLTF:: No geometry in " << path << endl;
+    return false;
+  }
+
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, bufferBytes, NULL, GL_STATIC_DRAW);
+  for (auto &entry : viewOffsets) {
+    const Json &view = views[size_t(entry.first)];
+    const auto &source = buffers[view["buffer"].index()];
+    glBufferSubData(GL_COPY_WRITE_BUFFER, entry.second,
+                    size_t(view["byteLength"].num()),
+                    source.first + size_t(view["byteOffset"].num()));
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  // textures of a glTF material, resolved once per material
+  map<int, vector<Texture>> materialTextures;
+  auto textureOf = [&](const Json &info, const string &type,
+                       vector<Texture> &out) {
+    const Json &texture = doc["textures"][size_t(info["index"].index())];
+    const Json &image = doc["images"][size_t(texture["source"].index())];
+    const string &uri = image["uri"].text;
+    if (info.isNull() || uri.empty() || uri.compare(0, 5, "data:") == 0)
+      return;
+    Texture t;
+    t.type = type;
+    t.path = decodeUri(uri);
+    t.id = textureRegistry.acquire(
+        t.path, directory, type == "texture_diffuse",
+        type == "texture_diffuse"  ? TEXTURE_COLOR
+        : type == "texture_normal" ? TEXTURE_NORMAL
+                                   : TEXTURE_DATA);
+    textures.push_back(t.id);
+    out.push_back(t);
+  };
+  auto materialOf = [&](int index) -> const vector<Texture> & {
+    auto it = materialTextures.find(index);
+    if (it != materialTextures.end())
+      return it->second;
+    vector<Texture> &out = materialTextures[index];
+    const Json &material = doc["materials"][size_t(index)];
+    if (material.isNull())
+      return out;
+    const Json &extensions = material["extensions"];
+    textureOf(material["pbrMetallicRoughness"]["baseColorTexture"],
+              "texture_diffuse", out);
+    if (out.empty())
+      textureOf(extensions["KHR_materials_pbrSpecularGlossiness"]
+                          ["diffuseTexture"],
+                "texture_diffuse", out);
+    textureOf(extensions["KHR_materials_specular"]["specularColorTexture"],
+              "texture_specular", out);
+    textureOf(extensions["KHR_materials_pbrSpecularGlossiness"]
+                        ["specularGlossinessTexture"],
+              "texture_specular", out);
+    textureOf(material["normalTexture"], "texture_normal", out);
+    return out;
+  };
+
+  // one VAO per primitive, straight on the uploaded views
+  vector<pair<unsigned int, unsigned int>> meshPrimitives; // first, count
+  glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+  vector<pair<glm::vec3, glm::vec3>> primitiveBounds;
+  for (size_t m = 0; m < meshes.size(); m++) {
+    meshPrimitives.push_back({unsigned(primitives.size()), 0});
+    for (size_t p = 0; p < meshes[m]["primitives"].size(); p++) {
+      const Json &source = meshes[m]["primitives"][p];
+      const Json &attributes = source["attributes"];
+      Accessor position;
+      if (!readAccessor(doc, attributes["POSITION"].index(), position) ||
+          !viewOffsets.count(position.view))
+        continue;
+
+      Primitive primitive;
+      primitive.mode = GLenum(source["mode"].num(GL_TRIANGLES));
+      primitive.count = position.count;
+      glGenVertexArrays(1, &primitive.vao);
+      glBindVertexArray(primitive.vao);
+      glBindBuffer(GL_ARRAY_BUFFER, buffer);
+      for (auto &attribute : ATTRIBUTES) {
+        Accessor accessor;
+        if (!readAccessor(doc, attributes[attribute.first].index(),
+                          accessor) ||
+            !viewOffsets.count(accessor.view))
+          continue;
+        const Json &view = views[size_t(accessor.view)];
+        glEnableVertexAttribArray(attribute.second);
+        glVertexAttribPointer(
+            attribute.second, accessor.components, accessor.componentType,
+            accessor.normalized, GLsizei(view["byteStride"].num()),
+            (void *)(viewOffsets[accessor.view] + accessor.offset));
+      }
+      Accessor indices;
+      if (readAccessor(doc, source["indices"].index(), indices) &&
+          viewOffsets.count(indices.view)) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+        primitive.indexType = indices.componentType;
+        primitive.indexOffset = viewOffsets[indices.view] + indices.offset;
+        primitive.count = indices.count;
+      }
+      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+      primitive.material = Material(materialOf(source["material"].index()));
+      primitives.push_back(std::move(primitive));
+      meshPrimitives.back().second++;
+
+      // POSITION accessors carry their bounds
+      const Json &accessor = doc["accessors"][size_t(
+          attributes["POSITION"].index())];
+      const Json &lower = accessor["min"], &upper = accessor["max"];
+      primitiveBounds.push_back(
+          {glm::vec3(lower[0].num(), lower[1].num(), lower[2].num()),
+           glm::vec3(upper[0].num(), upper[1].num(), upper[2].num())});
+    }
+  }
+
+  // flatten the node hierarchy of the default scene into draws
+  vector<pair<int, glm::mat4>> toVisit;
+  const Json &scene = doc["scenes"][size_t(max(doc["scene"].index(), 0))];
+  for (size_t i = 0; i < scene["nodes"].size(); i++)
+    toVisit.push_back({scene["nodes"][i].index(), glm::mat4(1.f)});
+  vector<bool> visited(doc["nodes"].size(), false);
+  vector<glm::vec3> corners;
+  while (!toVisit.empty()) {
+    int index = toVisit.back().first;
+    glm::mat4 parent = toVisit.back().second;
+    toVisit.pop_back();
+    if (index < 0 || size_t(index) >= visited.size() || visited[index])
+      continue;
+    visited[index] = true;
+    const Json &node = doc["nodes"][size_t(index)];
+    glm::mat4 world = parent * nodeTransform(node);
+    int mesh = node["mesh"].index();
+    if (mesh >= 0 && size_t(mesh) < meshPrimitives.size())
+      for (unsigned int i = 0; i < meshPrimitives[mesh].second; i++) {
+        unsigned int primitive = meshPrimitives[mesh].first + i;
+        draws.push_back({world, primitive});
+        const auto &bounds = primitiveBounds[primitive];
+        for (int c = 0; c < 8; c++) {
+          glm::vec3 corner((c & 1 ? bounds.second : bounds.first).x,
+                           (c & 2 ? bounds.second : bounds.first).y,
+                           (c & 4 ? bounds.second : bounds.first).z);
+          corners.push_back(glm::vec3(world * glm::vec4(corner, 1.f)));
+        }
+      }
+    for (size_t i = 0; i < node["children"].size(); i++)
+      toVisit.push_back({node["children"][i].index(), world});
+  }
+  for (auto &corner : corners) {
+    lo = glm::min(lo, corner);
+    hi = glm::max(hi, corner);
+  }
+  if (!corners.empty()) {
+    boundsCenter = (lo + hi) * 0.5f;
+    for (auto &corner : corners)
+      boundsRadius = max(boundsRadius, glm::length(corner - boundsCenter));
+  }
+
+  cout << "glTF loaded natively: " << path << " (" << primitives.size()
+       << " primitives, " << draws.size() << " draws, "
+       << bufferBytes / 1048576.0 << " MB)" << endl;
+  return true;
+}
+
+void GltfScene::Draw(const Shader &shader, const glm::mat4 &model) const {
+  // textures may have been bound behind the materials' back
+  invalidateMaterialBindings();
+  for (auto &draw : draws) {
+    const Primitive &primitive = primitives[draw.primitive];
+    shader.setMat4("model", model * draw.world);
+    primitive.material.bind(shader);
+    glBindVertexArray(primitive.vao);
+    if (primitive.indexType)
+      glDrawElements(primitive.mode, primitive.count, primitive.indexType,
+                     (void *)primitive.indexOffset);
+    else
+      glDrawArrays(primitive.mode, 0, primitive.count);
+    if (primitive.mode == GL_TRIANGLES)
+      debugData.addTriangles(primitive.count / 3);
+    debugData.addDrawCalls(1, 1);
+  }
+  glBindVertexArray(0);
+  glActiveTexture(GL_TEXTURE0);
+}
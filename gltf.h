@@ -0,0 +1,78 @@
+#ifndef GLTF_H
+#define GLTF_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "material.h"
+#include "shader_s.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Native glTF 2.0 / GLB loader. The buffer views the meshes use are copied
+// straight from the memory-mapped .bin (or the GLB binary chunk) into one
+// GL buffer, and every primitive gets a VAO that points at its accessors as
+// they are, so nothing is converted to Vertex on the way. Node transforms
+// are baked into a flat draw list at load time.
+//
+// Materials map onto the engine's conventions: base color is
+// texture_diffuse, the normal texture texture_normal and a specular
+// (KHR_materials_specular / pbrSpecularGlossiness) texture texture_specular.
+// Skins, sparse accessors and embedded (data: or buffer view) buffers and
+// images are not supported. load() fails on skins and embedded buffers so
+// the caller can fall back to Assimp; primitives with sparse accessors are
+// skipped.
+class GltfScene {
+public:
+  // bounding sphere of all primitives in model space
+  glm::vec3 boundsCenter = glm::vec3(0.f);
+  float boundsRadius = 0.f;
+
+  GltfScene() = default;
+  ~GltfScene();
+  GltfScene(const GltfScene &) = delete;
+  GltfScene &operator=(const GltfScene &) = delete;
+
+  // true for .gltf and .glb paths
+  static bool handles(const string &path);
+
+  // maps the file and its buffers and uploads the geometry. GL thread only.
+  // Returns false, with nothing allocated, if the file can't be drawn.
+  bool load(const string &path);
+
+  // draws every primitive at model * its node transform. Sets the "model"
+  // uniform per node.
+  void Draw(const Shader &shader, const glm::mat4 &model) const;
+
+  size_t gpuBytes() const { return bufferBytes; }
+  size_t primitiveCount() const { return primitives.size(); }
+
+private:
+  struct Primitive {
+    unsigned int vao = 0;
+    GLenum mode = GL_TRIANGLES;
+    GLenum indexType = 0; // 0 draws without indices
+    size_t indexOffset = 0; // bytes into the buffer
+    unsigned int count = 0;
+    Material material;
+  };
+  struct DrawItem {
+    glm::mat4 world;
+    unsigned int primitive;
+  };
+
+  string directory;
+  unsigned int buffer = 0;
+  size_t bufferBytes = 0;
+  vector<Primitive> primitives;
+  vector<DrawItem> draws;
+  vector<unsigned int> textures; // registry references, released on delete
+
+  void release();
+};
+
+#endif
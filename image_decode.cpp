@@ -0,0 +1,246 @@
+#include "image_decode.h"
+#include "mapped_file.h"
+#include "stb_image.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+using namespace std;
+
+// every x64 CPU has SSSE3, but MSVC never defines __SSSE3__
+#if defined(__SSSE3__) || defined(__AVX__) || defined(_M_X64)
+#define IMAGE_DECODE_SSSE3
+#include <tmmintrin.h>
+#endif
+
+namespace {
+// rows per job when an image is split across the worker pool
+const int ROWS_PER_JOB = 32;
+
+void forRowRanges(int height, const function<void(int, int)> &body) {
+  int jobs = (height + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+  if (jobs <= 1) {
+    body(0, height);
+    return;
+  }
+  getWorkerPool().parallelFor(jobs, [&](size_t job) {
+    int first = int(job) * ROWS_PER_JOB;
+    body(first, min(first + ROWS_PER_JOB, height));
+  });
+}
+
+unsigned char *allocatePixels(int width, int height, int channels) {
+  return static_cast<unsigned char *>(
+      malloc(max<size_t>(size_t(width) * height * channels, 1)));
+}
+
+bool hasTgaExtension(const string &path) {
+  if (path.size() < 4)
+    return false;
+  string extension = path.substr(path.size() - 4);
+  for (char &c : extension)
+    c = char(tolower((unsigned char)c));
+  return extension == ".tga";
+}
+
+// converts texels of a TGA into the output layout: grey stays, BGR and BGRA
+// become RGBA
+void convertTexels(const unsigned char *src, unsigned char *dst,
+                   size_t texels, int bytesPerTexel) {
+  if (bytesPerTexel == 1)
+    memcpy(dst, src, texels);
+  else if (bytesPerTexel == 3)
+    expandToRGBA(src, dst, texels, true);
+  else
+    swizzleBGRA(src, dst, texels);
+}
+
+// Uncompressed and RLE TGAs in 8-bit grey, BGR or BGRA, without colour
+// maps and stored left to right. False for anything else, which stb_image
+// then reads instead.
+bool decodeTga(const unsigned char *file, size_t size, DecodedImage &image) {
+  if (size < 18)
+    return false;
+  int idLength = file[0], colorMapType = file[1], imageType = file[2];
+  int width = file[12] | file[13] << 8, height = file[14] | file[15] << 8;
+  int bits = file[16], descriptor = file[17];
+  bool rle = imageType == 10 || imageType == 11;
+  bool grey = imageType == 3 || imageType == 11;
+  if (colorMapType != 0 || !(imageType == 2 || imageType == 3 || rle) ||
+      width == 0 || height == 0 || (descriptor & 0x10))
+    return false;
+  if (grey ? bits != 8 : bits != 24 && bits != 32)
+    return false;
+  int bytesPerTexel = bits / 8;
+  int channels = grey ? 1 : 4;
+  bool topDown = descriptor & 0x20;
+  const unsigned char *data = file + 18 + idLength;
+  const unsigned char *end = file + size;
+  if (data > end)
+    return false;
+
+  // where each stored row starts; RLE rows are found by walking the packet
+  // headers, the pixels are only touched by the row jobs
+  vector<const unsigned char *> rows(height);
+  size_t rowBytes = size_t(width) * bytesPerTexel;
+  if (!rle) {
+    if (size_t(end - data) < rowBytes * height)
+      return false;
+    for (int y = 0; y < height; y++)
+      rows[y] = data + rowBytes * y;
+  } else {
+    const unsigned char *p = data;
+    for (int y = 0; y < height; y++) {
+      rows[y] = p;
+      for (int x = 0; x < width;) {
+        if (p >= end)
+          return false;
+        int count = (*p & 0x7f) + 1;
+        // packets across rows are legal but rare; those files go to stb
+        if (x + count > width)
+          return false;
+        p += 1 + ((*p & 0x80) ? bytesPerTexel : count * bytesPerTexel);
+        if (p > end)
+          return false;
+        x += count;
+      }
+    }
+  }
+
+  unsigned char *pixels = allocatePixels(width, height, channels);
+  if (!pixels)
+    return false;
+  image.pixels.reset(pixels);
+  image.width = width;
+  image.height = height;
+  image.channels = channels;
+  size_t outRowBytes = size_t(width) * channels;
+  forRowRanges(height, [&](int first, int last) {
+    for (int y = first; y < last; y++) {
+      unsigned char *out =
+          pixels + outRowBytes * (topDown ? y : height - 1 - y);
+      const unsigned char *p = rows[y];
+      if (!rle) {
+        convertTexels(p, out, width, bytesPerTexel);
+        continue;
+      }
+      for (int x = 0; x < width;) {
+        int count = (*p & 0x7f) + 1;
+        if (*p & 0x80) {
+          unsigned char texel[4];
+          convertTexels(p + 1, texel, 1, bytesPerTexel);
+          for (int i = 0; i < count; i++)
+            memcpy(out + size_t(x + i) * channels, texel, channels);
+          p += 1 + bytesPerTexel;
+        } else {
+          convertTexels(p + 1, out + size_t(x) * channels, count,
+                        bytesPerTexel);
+          p += 1 + count * bytesPerTexel;
+        }
+        x += count;
+      }
+    }
+  });
+  return true;
+}
+} // namespace
+
+void expandToRGBA(const unsigned char *src, unsigned char *rgba,
+                  size_t texels, bool bgr) {
+  size_t i = 0;
+#ifdef IMAGE_DECODE_SSSE3
+  // picks 4 texels of 3 bytes out of 12, the alpha bytes come from the OR
+  const __m128i shuffle =
+      bgr ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+          : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                          -1);
+  const __m128i alpha = _mm_set1_epi32(int(0xff000000));
+  for (; i + 16 <= texels; i += 16) {
+    const __m128i *in = reinterpret_cast<const __m128i *>(src + i * 3);
+    __m128i a = _mm_loadu_si128(in), b = _mm_loadu_si128(in + 1),
+            c = _mm_loadu_si128(in + 2);
+    __m128i *out = reinterpret_cast<__m128i *>(rgba + i * 4);
+    _mm_storeu_si128(out, _mm_or_si128(_mm_shuffle_epi8(a, shuffle), alpha));
+    _mm_storeu_si128(out + 1,
+                     _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12),
+                                                   shuffle),
+                                  alpha));
+    _mm_storeu_si128(out + 2,
+                     _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8),
+                                                   shuffle),
+                                  alpha));
+    _mm_storeu_si128(out + 3,
+                     _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4),
+                                                   shuffle),
+                                  alpha));
+  }
+#endif
+  int r = bgr ? 2 : 0, b = bgr ? 0 : 2;
+  for (; i < texels; i++) {
+    rgba[i * 4] = src[i * 3 + r];
+    rgba[i * 4 + 1] = src[i * 3 + 1];
+    rgba[i * 4 + 2] = src[i * 3 + b];
+    rgba[i * 4 + 3] = 255;
+  }
+}
+
+void swizzleBGRA(const unsigned char *src, unsigned char *rgba,
+                 size_t texels) {
+  size_t i = 0;
+#ifdef IMAGE_DECODE_SSSE3
+  const __m128i shuffle =
+      _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  for (; i + 4 <= texels; i += 4) {
+    __m128i texel =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(rgba + i * 4),
+                     _mm_shuffle_epi8(texel, shuffle));
+  }
+#endif
+  for (; i < texels; i++) {
+    unsigned char blue = src[i * 4];
+    rgba[i * 4] = src[i * 4 + 2];
+    rgba[i * 4 + 1] = src[i * 4 + 1];
+    rgba[i * 4 + 2] = blue;
+    rgba[i * 4 + 3] = src[i * 4 + 3];
+  }
+}
+
+bool decodeImage(const string &path, DecodedImage &image) {
+  MappedFile file;
+  if (!file.open(path))
+    return false;
+  if (hasTgaExtension(path) && decodeTga(file.data(), file.size(), image))
+    return true;
+
+  int width, height, channels;
+  unsigned char *pixels = stbi_load_from_memory(
+      file.data(), int(file.size()), &width, &height, &channels, 0);
+  if (!pixels)
+    return false;
+  image.width = width;
+  image.height = height;
+  if (channels != 3) {
+    image.channels = channels;
+    image.pixels.reset(pixels);
+    return true;
+  }
+  unsigned char *rgba = allocatePixels(width, height, 4);
+  if (!rgba) {
+    stbi_image_free(pixels);
+    return false;
+  }
+  forRowRanges(height, [&](int first, int last) {
+    expandToRGBA(pixels + size_t(first) * width * 3,
+                 rgba + size_t(first) * width * 4,
+                 size_t(last - first) * width);
+  });
+  stbi_image_free(pixels);
+  image.channels = 4;
+  image.pixels.reset(rgba);
+  return true;
+}
@@ -0,0 +1,34 @@
+#ifndef IMAGE_DECODE_H
+#define IMAGE_DECODE_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <string>
+using namespace std;
+
+// An 8-bit image, rows top to bottom. RGB sources come back as RGBA, which
+// is how the texture code stores them anyway.
+struct DecodedImage {
+  int width = 0, height = 0;
+  int channels = 0; // 1, 2 or 4
+  // malloc'd, like stb_image's own results
+  unique_ptr<unsigned char, void (*)(void *)> pixels{nullptr, free};
+
+  size_t size() const { return size_t(width) * height * channels; }
+};
+
+// Decodes an image file. TGAs (uncompressed, or RLE whose packets stay
+// within rows) are decoded here in row ranges on the worker pool; other
+// formats go through stb_image, and their RGB to RGBA expansion is split
+// the same way. Safe to call from workers.
+bool decodeImage(const string &path, DecodedImage &image);
+
+// RGB (or BGR) to RGBA with opaque alpha. 16 texels per step with SSSE3.
+void expandToRGBA(const unsigned char *src, unsigned char *rgba,
+                  size_t texels, bool bgr = false);
+// BGRA to RGBA, src and rgba may be the same
+void swizzleBGRA(const unsigned char *src, unsigned char *rgba,
+                 size_t texels);
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "shader_s.h"
 #include "utils.h"
+#include "meshlet.h"
+#include "texture_streamer.h"
 #include <iostream>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -248,7 +250,13 @@ public:
     gBufferShader.use();
     gBufferShader.setVec3("viewPos", viewPos);
     transformation(gBufferShader);
+    // only this pass sees from the camera, so only it culls meshlets and
+    // tells the texture streamer what is on screen
+    clusterCulling.active = true;
+    textureStreamer.active = true;
     renderScene(gBufferShader);
+    clusterCulling.active = false;
+    textureStreamer.active = false;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     // glEnable(GL_BLEND); // Re-enable blend
 
@@ -0,0 +1,29 @@
+#include "lod.h"
+
+LodView lodView;
+
+float projectedSize(const glm::vec3 &center, float radius) {
+  float distance = glm::length(center - lodView.position);
+  if (distance <= radius)
+    return 1e9f; // the viewer is inside it
+  return 2.f * radius * lodView.projectionScale / distance;
+}
+
+unsigned int selectLod(float screenSize, unsigned int current,
+                       unsigned int levelCount) {
+  if (!lodView.enabled || levelCount <= 1)
+    return 0;
+  if (current >= levelCount)
+    current = levelCount - 1;
+  // level i is meant for sizes between switchSize(i) and switchSize(i - 1)
+  auto switchSize = [](unsigned int level) {
+    return LOD_SCREEN_SIZE / float(1u << level);
+  };
+  while (current > 0 &&
+         screenSize > switchSize(current - 1) * (1.f + LOD_HYSTERESIS))
+    current--;
+  while (current + 1 < levelCount &&
+         screenSize < switchSize(current) * (1.f - LOD_HYSTERESIS))
+    current++;
+  return current;
+}
@@ -0,0 +1,27 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <glm/glm.hpp>
+
+#include "config.h"
+
+// The viewer LOD levels are picked for. Set once per frame from the main
+// camera and used by every pass, so shadow maps match what is on screen.
+struct LodView {
+  glm::vec3 position = glm::vec3(0.f);
+  // pixels per unit of size at distance 1: height / (2 * tan(fovy / 2))
+  float projectionScale = 0.f;
+  bool enabled = true;
+};
+
+extern LodView lodView;
+
+// diameter in pixels of a world-space bounding sphere seen from lodView
+float projectedSize(const glm::vec3 &center, float radius);
+
+// level for a projected size, keeping the current one while the size is
+// within LOD_HYSTERESIS of the switch point
+unsigned int selectLod(float screenSize, unsigned int current,
+                       unsigned int levelCount);
+
+#endif
@@ -11,6 +11,13 @@
 #include "light.h"
 #include "object.h"
 #include "debug.h"
+#include "texture_loader.h"
+#include "model_loader.h"
+#include "skinning.h"
+#include "texture_registry.h"
+#include "texture_streamer.h"
+#include "skybox.h"
+#include "benchmark.h"
 
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
@@ -44,6 +51,7 @@ bool drawBags = true;
 bool drawPaimon = true;
 bool drawRin = true;
 bool drawGaki = true;
+bool drawTrain = true;
 bool drawParallaxTest = true;
 int dirLightStyle = 1;
 int tonemapStyle = 1;
@@ -284,35 +292,6 @@ void setupHdrFBO(unsigned int &hdrFBO, unsigned int &texture_out,
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-unsigned int loadCubemap(vector<std::string> faces) {
-  stbi_set_flip_vertically_on_load(false);
-  unsigned int textureID;
-  glGenTextures(1, &textureID);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-  int width, height, nrChannels;
-  for (unsigned int i = 0; i < faces.size(); i++) {
-    unsigned char *data =
-        stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-    if (data) {
-      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_SRGB_ALPHA, width,
-                   height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-      stbi_image_free(data);
-    } else {
-      std::cout << "Cubemap texture failed to load at path: " << faces[i]
-                << std::endl;
-      stbi_image_free(data);
-    }
-  }
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-  // stbi_set_flip_vertically_on_load(true);
-
-  return textureID;
-}
-
 unsigned int getSkyboxVAO() {
   float skyboxVertices[] = {
       // positions
@@ -431,12 +410,19 @@ void Scene1(GLFWwindow *window) {
 
   // Load Models
   // ------------------
-  Object modelBag("model/backpack/backpack.obj", false);
-  Object modelGirl("model/girl/rin.obj");
-  Object modelSponza("model/sponza/sponza.obj");
-  Object modelPaimon("model/paimon/Paimon.obj");
-  Object modelGaki("model/mesugaki/cute anime girl.obj");
-  // Object modelTrain("model/train/scene.gltf");
+  // they load in the background and show up as they become ready. The
+  // vertex format benchmark needs the CPU copy of the bag and Sponza.
+  auto modelBag =
+      Object::loadAsync("model/backpack/backpack.obj", false, true,
+                        DEFAULT_VERTEX_FORMAT, GEOMETRY_KEEP);
+  auto modelGirl = Object::loadAsync("model/girl/rin.obj");
+  auto modelSponza =
+      Object::loadAsync("model/sponza/sponza.obj", true, true,
+                        DEFAULT_VERTEX_FORMAT, GEOMETRY_KEEP);
+  auto modelPaimon = Object::loadAsync("model/paimon/Paimon.obj");
+  auto modelGaki = Object::loadAsync("model/mesugaki/cute anime girl.obj");
+  // glTF goes through the native loader and is ready right away
+  auto modelTrain = Object::loadAsync("model/train/scene.gltf");
   // Object modelBagH("model/backpackH/scene.gltf");
 
   // Setup Screen Framebuffer & Shader
@@ -458,13 +444,8 @@ void Scene1(GLFWwindow *window) {
 
   // Load Cubemaps
   // ------------------
-  // vector<std::string> faces{"night/right.png", "night/left.png",
-  //                           "night/top.png",   "night/bottom.png",
-  //                           "night/front.png", "night/back.png"};
-  vector<std::string> faces{"skybox/right.jpg", "skybox/left.jpg",
-                            "skybox/top.jpg",   "skybox/bottom.jpg",
-                            "skybox/front.jpg", "skybox/back.jpg"};
-  unsigned int cubemapTexture = loadCubemap(faces);
+  // other sets are switched to from the graphic settings
+  skyboxLoader.request("skybox");
   Shader skyboxShader("skybox.vs", "skybox.fs");
   unsigned int skyboxVAO = getSkyboxVAO();
 
@@ -472,8 +453,14 @@ void Scene1(GLFWwindow *window) {
   // ------------------
   unsigned int brickDiffTex, brickNormalTex, brickDispTex;
   brickDiffTex = TextureFromFile("bricks2.jpg", "", true);
-  brickNormalTex = TextureFromFile("bricks2_normal.jpg", "");
+  brickNormalTex =
+      TextureFromFile("bricks2_normal.jpg", "", false, TEXTURE_NORMAL);
   brickDispTex = TextureFromFile("bricks2_disp.jpg", "");
+  // bound like a mesh's, so the material uniforms (arrays included) are all
+  // set for the quad instead of left over from the last mesh
+  Material brickMaterial({{brickDiffTex, "texture_diffuse", ""},
+                          {brickNormalTex, "texture_normal", ""},
+                          {brickDispTex, "texture_height", ""}});
 
   // Rendering Loop
   // ------------------
@@ -486,40 +473,42 @@ void Scene1(GLFWwindow *window) {
     transformation(shader);
     // Draw bags
     // -------------
-    if (drawBags)
+    if (drawBags && modelBag->ready())
       for (unsigned int i = 0; i < cubePositions.size(); i++) {
-        modelBag.position =
+        modelBag->position =
             cubePositions[i] +
             glm::vec3(0.f, sin(glfwGetTime() + i * 1.14) * 4.f + 100.f, 0.f);
-        modelBag.angle = 20.0f * i + glfwGetTime();
-        modelBag.axis = glm::vec3(1.0f, 0.3f, 0.5f);
+        modelBag->angle = 20.0f * i + glfwGetTime();
+        modelBag->axis = glm::vec3(1.0f, 0.3f, 0.5f);
 
-        modelBag.Draw(shader);
+        modelBag->Draw(shader, i);
         // modelMiku.Draw(shader);
       }
 
     // Draw Sponza
-    modelSponza.setScale(0.1);
-    modelSponza.Draw(shader);
+    if (modelSponza->ready()) {
+      modelSponza->setScale(0.1);
+      modelSponza->Draw(shader);
+    }
 
     // Draw Girl
-    if (drawRin) {
-      modelGirl.setPosition(0, 0, -10);
-      modelGirl.setScale(10);
-      modelGirl.Draw(shader);
+    if (drawRin && modelGirl->ready()) {
+      modelGirl->setPosition(0, 0, -10);
+      modelGirl->setScale(10);
+      modelGirl->Draw(shader);
     }
 
     // Draw Paimon
-    if (drawPaimon) {
-      modelGirl.setPosition(5, 0, -10);
-      modelPaimon.Draw(shader);
+    if (drawPaimon && modelPaimon->ready()) {
+      modelGirl->setPosition(5, 0, -10);
+      modelPaimon->Draw(shader);
     }
 
     // Draw Gaki
-    if (drawGaki) {
-      modelGaki.setPosition(-20, 0, -10);
-      modelGaki.setScale(10);
-      modelGaki.Draw(shader);
+    if (drawGaki && modelGaki->ready()) {
+      modelGaki->setPosition(-20, 0, -10);
+      modelGaki->setScale(10);
+      modelGaki->Draw(shader);
     }
 
     // Draw backpack Highpoly ver
@@ -527,9 +516,11 @@ void Scene1(GLFWwindow *window) {
     // modelBagH.Draw(shader);
 
     // Draw Train
-    // modelTrain.setPosition(20, 0, 0);
-    // modelTrain.setScale(1);
-    // modelTrain.Draw(shader);
+    if (drawTrain && modelTrain->ready()) {
+      modelTrain->setPosition(20, 0, 0);
+      modelTrain->setScale(1);
+      modelTrain->Draw(shader);
+    }
 
     // Draw Parallax Test Surface
     if (drawParallaxTest) {
@@ -537,19 +528,7 @@ void Scene1(GLFWwindow *window) {
       model = glm::scale(model, glm::vec3(7.0f));
       model = glm::rotate(model, glm::radians(-90.f), glm::vec3(1.f, 0.f, 0.f));
       shader.setMat4("model", model);
-      shader.setInt("material.diffuse[0]", 0);
-      shader.setInt("material.normal[0]", 1);
-      shader.setInt("material.height[0]", 2);
-      shader.setInt("material.diffuse_c", 1);
-      shader.setInt("material.normal_c", 1);
-      shader.setInt("material.height_c", 1);
-      shader.setInt("material.specular_c", 0);
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, brickDiffTex);
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, brickNormalTex);
-      glActiveTexture(GL_TEXTURE2);
-      glBindTexture(GL_TEXTURE_2D, brickDispTex);
+      brickMaterial.bind(shader);
       render3DQuad();
     }
   };
@@ -621,6 +600,18 @@ void Scene1(GLFWwindow *window) {
       }
       ImGui::EndListBox();
     }
+    if (ImGui::BeginListBox("Skybox")) {
+      static const string _skyboxLists[] = {"skybox", "night"};
+      for (int i = 0; i < 2; i++) {
+        bool selected = _skyboxLists[i] == skyboxLoader.requested();
+        if (ImGui::Selectable(_skyboxLists[i].c_str(), selected) &&
+            !selected)
+          skyboxLoader.request(_skyboxLists[i]);
+      }
+      ImGui::EndListBox();
+    }
+    if (skyboxLoader.loading())
+      ImGui::Text("Skybox loading...");
 
     ImGui::Checkbox("Always display debug layer", &displayImGuiWhenFocus);
     ImGui::End();
@@ -628,6 +619,135 @@ void Scene1(GLFWwindow *window) {
     ImGui::Begin("Engine Debug Information");
     ImGui::Text("Estimate triangles: %d", debugData.triangles);
     ImGui::Text("Estimate indices: %d", debugData.indices);
+    ImGui::Text("Draw calls: %d (%d without batching)", debugData.drawCalls,
+                debugData.unbatchedDrawCalls);
+    ImGui::Text("Texture binds: %d (%d binding every texture)",
+                debugData.textureBinds, debugData.unpackedTextureBinds);
+    ImGui::Text("Texture arrays: %u, %u layers", textureArrayStats.arrays,
+                textureArrayStats.layers);
+    ImGui::Text("Textures streaming: %u", textureLoader.pending());
+    ImGui::Text("Models loading: %u", modelLoader.pending());
+    ImGui::Text("Skinned instances: %u, %zu joints",
+                skinning.posedInstances(), skinning.jointCount());
+    ImGui::Checkbox("Play animations", &skinning.playing);
+    ImGui::Checkbox("Mesh LOD", &lodView.enabled);
+    ImGui::Text("LOD saved triangles: %d", debugData.lodSavedTriangles);
+    ImGui::Checkbox("Meshlet culling", &clusterCulling.enabled);
+    ImGui::SameLine();
+    ImGui::Checkbox("Backface cones", &clusterCulling.cones);
+    ImGui::Text("Meshlet culled triangles: %d",
+                debugData.clusterCulledTriangles);
+    for (VertexFormat format : {VERTEX_FULL, VERTEX_COMPACT})
+      ImGui::Text("Geometry arena %s: %.1f / %.1f MB",
+                  format == VERTEX_COMPACT ? "compact" : "full",
+                  getGeometryArena(format).usedBytes() / 1048576.0,
+                  getGeometryArena(format).capacityBytes() / 1048576.0);
+    static string benchmarkReport;
+    if (ImGui::Button("Vertex format benchmark") && modelSponza->ready() &&
+        modelBag->ready())
+      benchmarkReport = benchmarkVertexFormats(modelSponza->model) + "\n" +
+                        benchmarkVertexFormats(modelBag->model);
+    if (!benchmarkReport.empty())
+      ImGui::TextUnformatted(benchmarkReport.c_str());
+    static string objBenchmarkReport;
+    if (ImGui::Button("OBJ import benchmark"))
+      objBenchmarkReport = benchmarkObjImport("model/sponza/sponza.obj");
+    if (!objBenchmarkReport.empty())
+      ImGui::TextUnformatted(objBenchmarkReport.c_str());
+    static string imageBenchmarkReport;
+    if (ImGui::Button("Image decode benchmark"))
+      imageBenchmarkReport = benchmarkImageDecode(
+          {"model/sponza/textures", "model/paimon", "model/mesugaki",
+           "model/girl"});
+    if (!imageBenchmarkReport.empty())
+      ImGui::TextUnformatted(imageBenchmarkReport.c_str());
+    ImGui::End();
+
+    ImGui::Begin("Texture Memory");
+    ImGui::Text("Textures: %zu, total %.1f MB, %.1f MB saved by compression "
+                "and streaming",
+                textureRegistry.size(), textureRegistry.totalBytes() / 1048576.0,
+                textureRegistry.savedBytes() / 1048576.0);
+    ImGui::Text("Deduplicated: %zu files, %.1f MB saved",
+                textureRegistry.aliases(),
+                textureRegistry.dedupedBytes() / 1048576.0);
+    if (TEXTURE_STREAMING) {
+      static int budgetMB = TEXTURE_STREAMING_BUDGET_MB;
+      if (ImGui::SliderInt("Streaming budget MB", &budgetMB, 16, 2048))
+        textureStreamer.budgetBytes = size_t(budgetMB) << 20;
+      ImGui::Text("Streamed: %zu textures, %.1f of %.1f MB resident, %zu "
+                  "loading",
+                  textureStreamer.size(),
+                  textureStreamer.residentBytes() / 1048576.0,
+                  textureStreamer.fullBytes() / 1048576.0,
+                  textureStreamer.loading());
+    }
+    if (ImGui::BeginTable("textures", 5,
+                          ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                              ImGuiTableFlags_ScrollY)) {
+      ImGui::TableSetupColumn("Path");
+      ImGui::TableSetupColumn("Size");
+      ImGui::TableSetupColumn("Refs");
+      ImGui::TableSetupColumn("MB");
+      ImGui::TableSetupColumn("Saved MB");
+      ImGui::TableHeadersRow();
+      for (auto &entry : textureRegistry.entries()) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%s%s", entry.path.c_str(), entry.srgb ? " (sRGB)" : "");
+        if (entry.aliases() > 0) {
+          ImGui::SameLine();
+          ImGui::Text("(+%d identical)", entry.aliases());
+        }
+        ImGui::TableNextColumn();
+        ImGui::Text("%dx%d", entry.width, entry.height);
+        ImGui::TableNextColumn();
+        ImGui::Text("%d", entry.refCount);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", entry.bytes / 1048576.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", (entry.uncompressedBytes - entry.bytes) / 1048576.0);
+      }
+      ImGui::EndTable();
+    }
+    ImGui::End();
+
+    ImGui::Begin("Geometry Memory");
+    if (ImGui::BeginTable("geometry", 5,
+                          ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+      ImGui::TableSetupColumn("Model");
+      ImGui::TableSetupColumn("Now MB");
+      ImGui::TableSetupColumn("Keep MB");
+      ImGui::TableSetupColumn("Positions MB");
+      ImGui::TableSetupColumn("Drop MB");
+      ImGui::TableHeadersRow();
+      size_t total[4] = {};
+      for (Object *object : {modelBag.get(), modelGirl.get(), modelSponza.get(),
+                             modelPaimon.get(), modelGaki.get()}) {
+        if (!object->ready())
+          continue;
+        Model &model = object->model;
+        size_t bytes[4] = {model.cpuBytes(), model.cpuBytes(GEOMETRY_KEEP),
+                           model.cpuBytes(GEOMETRY_POSITIONS),
+                           model.cpuBytes(GEOMETRY_DROP)};
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%s", model.directory.c_str());
+        for (int i = 0; i < 4; i++) {
+          ImGui::TableNextColumn();
+          ImGui::Text("%.2f", bytes[i] / 1048576.0);
+          total[i] += bytes[i];
+        }
+      }
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::Text("Total");
+      for (int i = 0; i < 4; i++) {
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", total[i] / 1048576.0);
+      }
+      ImGui::EndTable();
+    }
     ImGui::End();
 
     ImGui::Begin("Models");
@@ -635,6 +755,7 @@ void Scene1(GLFWwindow *window) {
     ImGui::Checkbox("Rin", &drawRin);
     ImGui::Checkbox("Paimon", &drawPaimon);
     ImGui::Checkbox("Gaki", &drawGaki);
+    ImGui::Checkbox("Train", &drawTrain);
     ImGui::Checkbox("Parallax Brickwall", &drawParallaxTest);
     ImGui::End();
 
@@ -646,6 +767,11 @@ void Scene1(GLFWwindow *window) {
 
     // Something else
     // -----------------
+    textureLoader.update();
+    textureStreamer.update();
+    skyboxLoader.update();
+    modelLoader.update();
+    skinning.update(deltaTime);
 
     // Pre-rendering
     // -----------------
@@ -654,6 +780,14 @@ void Scene1(GLFWwindow *window) {
     glBindFramebuffer(GL_FRAMEBUFFER, screenFBO);
     glEnable(GL_DEPTH_TEST);
     debugData.clear();
+    lodView.position = mainCam.Position;
+    lodView.projectionScale =
+        WINDOW_HEIGHT / (2.f * tan(glm::radians(mainCam.Zoom) * 0.5f));
+    clusterCulling.setView(
+        glm::perspective(glm::radians(mainCam.Zoom),
+                         1.f * WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, FAR_PLANE) *
+            mainCam.GetViewMatrix(),
+        mainCam.Position);
 
     // Rendering
     // -----------------
@@ -727,7 +861,7 @@ void Scene1(GLFWwindow *window) {
     // skybox cube
     glBindVertexArray(skyboxVAO);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxLoader.texture());
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glBindVertexArray(0);
     glDepthFunc(GL_LESS); // set depth function back to default
@@ -892,6 +1026,8 @@ int main() {
   // --------------
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  // filter across cube map faces, smaller skybox mips show seams otherwise
+  glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
   // glEnable(GL_CULL_FACE);
   glCullFace(GL_BACK);
 
@@ -0,0 +1,81 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string &path) {
+  close();
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  fileHandle = file;
+  mappingHandle = mapping;
+  bytes = static_cast<const unsigned char *>(view);
+  length = static_cast<size_t>(fileSize.QuadPart);
+  return true;
+}
+
+void MappedFile::close() {
+  if (bytes)
+    UnmapViewOfFile(bytes);
+  if (mappingHandle)
+    CloseHandle(mappingHandle);
+  if (fileHandle)
+    CloseHandle(fileHandle);
+  bytes = nullptr;
+  length = 0;
+  fileHandle = mappingHandle = nullptr;
+}
+#else
+bool MappedFile::open(const std::string &path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void *view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping keeps its own reference to the file
+  if (view == MAP_FAILED)
+    return false;
+  bytes = static_cast<const unsigned char *>(view);
+  length = static_cast<size_t>(st.st_size);
+  return true;
+}
+
+void MappedFile::close() {
+  if (bytes)
+    munmap(const_cast<unsigned char *>(bytes), length);
+  bytes = nullptr;
+  length = 0;
+}
+#endif
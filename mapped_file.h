@@ -0,0 +1,32 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the
+// object, so pointers handed out by data() must not outlive it.
+class MappedFile {
+public:
+  MappedFile() {}
+  ~MappedFile() { close(); }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool open(const std::string &path);
+  void close();
+
+  const unsigned char *data() const { return bytes; }
+  size_t size() const { return length; }
+  bool isOpen() const { return bytes != nullptr; }
+
+private:
+  const unsigned char *bytes = nullptr;
+  size_t length = 0;
+#ifdef _WIN32
+  void *fileHandle = nullptr;
+  void *mappingHandle = nullptr;
+#endif
+};
+
+#endif
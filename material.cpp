@@ -0,0 +1,117 @@
+#include "material.h"
+#include "debug.h"
+
+static const char *SLOT_NAMES[SLOT_COUNT] = {"diffuse", "specular", "normal",
+                                             "height"};
+
+// what each unit holds, so repeated binds can be skipped. 0 is unknown.
+static const int TRACKED_UNITS = MATERIAL_ARRAY_FIRST_UNIT + SLOT_COUNT;
+static unsigned int boundTextures[TRACKED_UNITS] = {};
+
+static void bindTexture(int unit, GLenum target, unsigned int id) {
+  if (unit < TRACKED_UNITS) {
+    if (boundTextures[unit] == id)
+      return;
+    boundTextures[unit] = id;
+  }
+  glActiveTexture(GL_TEXTURE0 + unit);
+  glBindTexture(target, id);
+  debugData.addTextureBinds(1);
+}
+
+void invalidateMaterialBindings() {
+  for (auto &id : boundTextures)
+    id = 0;
+}
+
+TextureSlot textureSlot(const string &type) {
+  if (type == "texture_diffuse")
+    return SLOT_DIFFUSE;
+  if (type == "texture_specular")
+    return SLOT_SPECULAR;
+  if (type == "texture_normal")
+    return SLOT_NORMAL;
+  if (type == "texture_height")
+    return SLOT_HEIGHT;
+  return SLOT_NONE;
+}
+
+Material::Material(const vector<Texture> &textures) {
+  for (auto &texture : textures) {
+    Binding binding;
+    binding.id = texture.id;
+    binding.slot = textureSlot(texture.type);
+    binding.index = binding.slot == SLOT_NONE ? -1 : counts[binding.slot]++;
+    bindings.push_back(binding);
+  }
+}
+
+Material::ProgramLocations Material::locations(unsigned int program) const {
+  ProgramLocations entry;
+  for (auto &binding : bindings) {
+    GLint location = -1;
+    if (binding.slot != SLOT_NONE) {
+      string name = string("material.") + SLOT_NAMES[binding.slot] + "[" +
+                    to_string(binding.index) + "]";
+      location = glGetUniformLocation(program, name.c_str());
+    }
+    entry.samplers.push_back(location);
+  }
+  for (int slot = 0; slot < SLOT_COUNT; slot++)
+    entry.counts[slot] = glGetUniformLocation(
+        program, (string("material.") + SLOT_NAMES[slot] + "_c").c_str());
+  entry.arrays = glGetUniformLocation(program, "material.arrays");
+  entry.layers = glGetUniformLocation(program, "material.layers");
+  return entry;
+}
+
+bool Material::canUseArrays() const {
+  for (int slot = 0; slot < SLOT_COUNT; slot++)
+    if (counts[slot] > 1)
+      return false;
+  for (auto &binding : bindings)
+    if (binding.slot == SLOT_NONE)
+      return false;
+  return true;
+}
+
+bool Material::useArrays(
+    const unordered_map<unsigned int, TextureLayer> &layers) {
+  if (!canUseArrays())
+    return false;
+  for (auto &binding : bindings)
+    if (!layers.count(binding.id))
+      return false;
+  for (auto &binding : bindings) {
+    const TextureLayer &layer = layers.at(binding.id);
+    slotArrays[binding.slot] = layer.array;
+    slotLayers[binding.slot] = layer.layer;
+  }
+  arrays = true;
+  return true;
+}
+
+void Material::bind(const Shader &shader) const {
+  const ProgramLocations &program = programs.get(
+      shader.ID, [this](unsigned int id) { return locations(id); });
+  // what binding every texture separately would cost
+  debugData.addUnpackedTextureBinds(bindings.size());
+  if (program.arrays >= 0)
+    glUniform1i(program.arrays, arrays);
+  if (arrays) {
+    for (int slot = 0; slot < SLOT_COUNT; slot++)
+      if (slotArrays[slot])
+        bindTexture(MATERIAL_ARRAY_FIRST_UNIT + slot, GL_TEXTURE_2D_ARRAY,
+                    slotArrays[slot]);
+    if (program.layers >= 0)
+      glUniform4iv(program.layers, 1, slotLayers);
+  } else
+    for (size_t i = 0; i < bindings.size(); i++) {
+      if (program.samplers[i] >= 0)
+        glUniform1i(program.samplers[i], int(i));
+      bindTexture(i, GL_TEXTURE_2D, bindings[i].id);
+    }
+  for (int slot = 0; slot < SLOT_COUNT; slot++)
+    if (program.counts[slot] >= 0)
+      glUniform1i(program.counts[slot], counts[slot]);
+}
@@ -0,0 +1,86 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include "shader_s.h"
+#include "texture_array.h"
+
+#include <string>
+#include <vector>
+using namespace std;
+
+struct Texture {
+  unsigned int id;
+  string type;
+  string path;
+};
+
+// sampler arrays of the shaders' Material struct
+enum TextureSlot {
+  SLOT_DIFFUSE,
+  SLOT_SPECULAR,
+  SLOT_NORMAL,
+  SLOT_HEIGHT,
+  SLOT_COUNT,
+  SLOT_NONE = SLOT_COUNT // unknown type: bound, but no shader samples it
+};
+
+// units of the diffuse/specular/normal/height sampler2DArrays; the shaders
+// declare them with layout(binding = ...) to match
+#define MATERIAL_ARRAY_FIRST_UNIT 12
+
+// slot of a texture type name such as "texture_diffuse"
+TextureSlot textureSlot(const string &type);
+
+// forgets which textures the units hold. Call after binding textures other
+// than through Material, before the next Material::bind.
+void invalidateMaterialBindings();
+
+// The texture bindings of a mesh, resolved once: texture i goes to unit i
+// and to the next free element of its slot's sampler array. Uniform
+// locations are looked up the first time a program draws the material and
+// cached, so binding costs no string work and no allocation afterwards.
+// Materials with at most one texture per slot can switch to texture arrays,
+// after which binding is just layer indices plus whatever arrays the
+// previous draw didn't already have bound.
+class Material {
+public:
+  Material() = default;
+  explicit Material(const vector<Texture> &textures);
+
+  // true if every slot holds at most one texture
+  bool canUseArrays() const;
+  // samples the textures from their layers from now on. False (and no
+  // change) if a texture is missing from layers.
+  bool useArrays(const unordered_map<unsigned int, TextureLayer> &layers);
+  bool usesArrays() const { return arrays; }
+
+  // binds the textures to their units and points the shader's material
+  // uniforms at them
+  void bind(const Shader &shader) const;
+
+private:
+  struct Binding {
+    unsigned int id;
+    TextureSlot slot;
+    int index; // element of the slot's sampler array
+  };
+  // uniform locations of one program
+  struct ProgramLocations {
+    vector<GLint> samplers; // per binding
+    GLint counts[SLOT_COUNT];
+    GLint arrays, layers;
+  };
+
+  vector<Binding> bindings;
+  int counts[SLOT_COUNT] = {};
+  bool arrays = false;
+  unsigned int slotArrays[SLOT_COUNT] = {}; // with arrays, 0 if empty
+  int slotLayers[SLOT_COUNT] = {-1, -1, -1, -1};
+  mutable ProgramCache<ProgramLocations> programs;
+
+  ProgramLocations locations(unsigned int program) const;
+};
+
+#endif
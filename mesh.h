@@ -8,157 +8,274 @@
 
 #include "shader_s.h"
 #include "debug.h"
+#include "vertex.h"
+#include "geometry_arena.h"
+#include "meshlet.h"
+#include "material.h"
 
+#include <cmath>
+#include <cstdint>
 #include <string>
 #include <vector>
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-  // position
-  glm::vec3 Position;
-  // normal
-  glm::vec3 Normal;
-  // texCoords
-  glm::vec2 TexCoords;
-  // tangent
-  glm::vec3 Tangent;
-  // bitangent
-  glm::vec3 Bitangent;
-  // bone indexes which will influence this vertex
-  int m_BoneIDs[MAX_BONE_INFLUENCE];
-  // weights from each bone
-  float m_Weights[MAX_BONE_INFLUENCE];
+// CPU-side geometry of a mesh before its GL buffers exist
+struct MeshData {
+  vector<Vertex> vertices;
+  vector<unsigned int> indices;
+  vector<vector<unsigned int>> lodIndices; // simplified levels, coarser last
+  vector<Meshlet> meshlets; // clusters of the full detail indices, in order
+  vector<SkinVertex> skin; // one per vertex for skinned meshes, else empty
+  unsigned int materialIndex = 0;
+  unsigned int sourceMeshes = 1; // imported meshes merged into this one
+};
+
+// What a mesh keeps in system memory once its geometry is on the GPU.
+enum GeometryResidency {
+  GEOMETRY_KEEP,      // vertices, skin and all index levels
+  GEOMETRY_POSITIONS, // positions and full detail indices, for culling/picking
+  GEOMETRY_DROP       // nothing but the meshlet bounds
 };
 
-struct Texture {
-  unsigned int id;
-  string type;
-  string path;
+// index range of one LOD level inside a mesh's arena allocation
+struct MeshLod {
+  unsigned int firstIndex;
+  unsigned int indexCount;
 };
 
 class Mesh {
 public:
   // mesh Data
+  // CPU copies, emptied according to residency once uploaded
   vector<Vertex> vertices;
   vector<unsigned int> indices;
+  vector<vector<unsigned int>> lodIndices; // simplified levels, coarser last
+  vector<glm::vec3> positions; // only kept with GEOMETRY_POSITIONS
+  vector<SkinVertex> skin;
+  GeometryResidency residency;
+  bool skinned; // has a skin stream on the GPU
+  unsigned int vertexCount; // uploaded, whatever is still resident
+  vector<Meshlet> meshlets; // cover the full detail indices back to back
   vector<Texture> textures;
-  unsigned int VAO;
+  Material material; // textures resolved for binding
+  unsigned int sourceMeshes = 1; // imported meshes merged into this one
+  vector<MeshLod> lods; // level 0 is full detail
+  VertexFormat format; // layout actually uploaded
+  GLenum indexType;    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT on the GPU
+  GeometryArena *arena; // holds the GPU copy of the geometry
+  unsigned int geometry; // handle in the arena
+  // model space bounding sphere, and the model space length one UV unit
+  // covers on average (0 without texture coordinates); the texture streamer
+  // derives the mip levels the mesh needs from them
+  glm::vec3 boundsCenter = glm::vec3(0.f);
+  float boundsRadius = 0.f;
+  float uvScale = 0.f;
 
-  // constructor
+  // constructor. A compact format request falls back to the full layout for
+  // meshes the compact one can't represent. Pass the geometry in with
+  // std::move, it is not copied again on the way to the GPU. A skin makes
+  // the mesh skinned and needs one entry per vertex.
   Mesh(vector<Vertex> vertices, vector<unsigned int> indices,
-       vector<Texture> textures) {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+       vector<Texture> textures, VertexFormat format = VERTEX_FULL,
+       vector<vector<unsigned int>> lodIndices = {},
+       vector<Meshlet> meshlets = {},
+       GeometryResidency residency = GEOMETRY_KEEP,
+       vector<SkinVertex> skin = {}) {
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->lodIndices = std::move(lodIndices);
+    this->meshlets = std::move(meshlets);
+    this->skin = std::move(skin);
+    this->skinned = this->skin.size() == this->vertices.size() &&
+                    !this->skin.empty();
+    this->textures = std::move(textures);
+    this->material = Material(this->textures);
+    this->format = format;
+    this->residency = GEOMETRY_KEEP;
 
-    // now that we have all the required data, set the vertex buffers and its
-    // attribute pointers.
+    measureBounds();
+    // now that we have all the required data, copy it to the GPU
     setupMesh();
+    setResidency(residency);
+  }
+
+  // drops the CPU copies the policy doesn't keep. Dropped data can't come
+  // back, so only moves towards GEOMETRY_DROP take effect.
+  void setResidency(GeometryResidency policy) {
+    if (policy <= residency)
+      return;
+    if (policy == GEOMETRY_POSITIONS) {
+      positions.reserve(vertices.size());
+      for (auto &vertex : vertices)
+        positions.push_back(vertex.Position);
+    } else {
+      vector<glm::vec3>().swap(positions);
+      vector<unsigned int>().swap(indices);
+    }
+    vector<Vertex>().swap(vertices);
+    vector<SkinVertex>().swap(skin);
+    vector<vector<unsigned int>>().swap(lodIndices);
+    residency = policy;
+  }
+
+  // system memory the geometry of this mesh takes now
+  size_t cpuBytes() const {
+    size_t bytes = vertices.capacity() * sizeof(Vertex) +
+                   indices.capacity() * sizeof(unsigned int) +
+                   positions.capacity() * sizeof(glm::vec3) +
+                   skin.capacity() * sizeof(SkinVertex) +
+                   meshlets.capacity() * sizeof(Meshlet);
+    for (auto &lod : lodIndices)
+      bytes += lod.capacity() * sizeof(unsigned int);
+    return bytes;
+  }
+
+  // system memory the geometry would take under a residency policy
+  size_t cpuBytes(GeometryResidency policy) const {
+    size_t bytes = meshlets.size() * sizeof(Meshlet);
+    if (policy == GEOMETRY_KEEP) {
+      bytes += vertexCount * sizeof(Vertex);
+      if (skinned)
+        bytes += vertexCount * sizeof(SkinVertex);
+      for (auto &lod : lods)
+        bytes += lod.indexCount * sizeof(unsigned int);
+    } else if (policy == GEOMETRY_POSITIONS)
+      bytes += vertexCount * sizeof(glm::vec3) +
+               lods[0].indexCount * sizeof(unsigned int);
+    return bytes;
   }
 
   // render the mesh
-  void Draw(Shader &shader) {
+  void Draw(Shader &shader, unsigned int lod = 0,
+            const CullFrame *cull = nullptr) {
+    arena->bind();
+    DrawBound(shader, lod, cull);
+    glBindVertexArray(0);
+  }
+
+  // renders the mesh with its arena already bound, so consecutive meshes of
+  // the same format skip the VAO switch. Levels past the coarsest one this
+  // mesh has draw the coarsest. With a cull frame, full detail only draws
+  // the meshlets it can see.
+  void DrawBound(Shader &shader, unsigned int lod = 0,
+                 const CullFrame *cull = nullptr) {
     // bind appropriate textures
-    unsigned int diffuseNr = 0;
-    unsigned int specularNr = 0;
-    unsigned int normalNr = 0;
-    unsigned int heightNr = 0;
-    glBindVertexArray(VAO);
-    for (unsigned int i = 0; i < textures.size(); i++) {
-      glActiveTexture(GL_TEXTURE0 +
-                      i); // active proper texture unit before binding
-      // retrieve texture number (the N in diffuse_textureN)
-      string number;
-      string name = textures[i].type;
-      if (name == "texture_diffuse")
-        number = "diffuse[" + std::to_string(diffuseNr++) + "]";
-      else if (name == "texture_specular")
-        number = "specular[" + std::to_string(specularNr++) +
-                 "]"; // transfer unsigned int to string
-      else if (name == "texture_normal")
-        number = "normal[" + std::to_string(normalNr++) +
-                 "]"; // transfer unsigned int to string
-      else if (name == "texture_height")
-        number = "height[" + std::to_string(heightNr++) +
-                 "]"; // transfer unsigned int to string
-
-      // now set the sampler to the correct texture unit
-      glUniform1i(glGetUniformLocation(shader.ID, ("material." + number).c_str()), i);
-      // and finally bind the texture
-      glBindTexture(GL_TEXTURE_2D, textures[i].id);
-    }
-    shader.setInt("material.diffuse_c", diffuseNr);
-    shader.setInt("material.specular_c", specularNr);
-    shader.setInt("material.normal_c", normalNr);
-    shader.setInt("material.height_c", heightNr);
+    material.bind(shader);
 
     // draw mesh
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()),
-                   GL_UNSIGNED_INT, 0);
-    debugData.addTriangles(indices.size() / 3);
-    glBindVertexArray(0);
+    const MeshLod &level = lods[min<size_t>(lod, lods.size() - 1)];
+    if (cull && level.firstIndex == 0 && !meshlets.empty())
+      drawMeshlets(*cull);
+    else {
+      arena->draw(geometry, level.firstIndex, level.indexCount);
+      debugData.addTriangles(level.indexCount / 3);
+      debugData.addDrawCalls(1, sourceMeshes);
+    }
+    debugData.addLodSavedTriangles((lods[0].indexCount - level.indexCount) / 3);
 
     // always good practice to set everything back to defaults once configured.
     glActiveTexture(GL_TEXTURE0);
   }
 
+  // gives the geometry back to the arena. Meshes are copied around freely,
+  // so this is left to the owner (Model) instead of a destructor.
+  void release() { arena->free(geometry); }
+
 private:
-  // render data
-  unsigned int VBO, EBO;
+  // draws the visible meshlets with one multi-draw, joining neighbours into
+  // a single range
+  void drawMeshlets(const CullFrame &cull) {
+    static vector<unsigned int> firstIndices;
+    static vector<GLsizei> counts;
+    firstIndices.clear();
+    counts.clear();
+    unsigned int drawn = 0;
+    for (const Meshlet &meshlet : meshlets) {
+      if (!cull.visible(meshlet))
+        continue;
+      if (!counts.empty() &&
+          firstIndices.back() + counts.back() == meshlet.firstIndex)
+        counts.back() += meshlet.indexCount;
+      else {
+        firstIndices.push_back(meshlet.firstIndex);
+        counts.push_back(meshlet.indexCount);
+      }
+      drawn += meshlet.indexCount;
+    }
+    if (!counts.empty()) {
+      arena->drawRanges(geometry, firstIndices.data(), counts.data(),
+                        counts.size());
+      debugData.addDrawCalls(1, sourceMeshes);
+    }
+    debugData.addTriangles(drawn / 3);
+    debugData.addClusterCulledTriangles((lods[0].indexCount - drawn) / 3);
+  }
+
+  void measureBounds() {
+    if (vertices.empty())
+      return;
+    glm::vec3 lo = vertices[0].Position, hi = lo;
+    for (auto &vertex : vertices) {
+      lo = glm::min(lo, vertex.Position);
+      hi = glm::max(hi, vertex.Position);
+    }
+    boundsCenter = (lo + hi) * 0.5f;
+    for (auto &vertex : vertices)
+      boundsRadius =
+          max(boundsRadius, glm::length(vertex.Position - boundsCenter));
+    // ratio of the total surface to the total UV area
+    double area = 0.0, uvArea = 0.0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      const Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]],
+                   &c = vertices[indices[i + 2]];
+      area += glm::length(
+          glm::cross(b.Position - a.Position, c.Position - a.Position));
+      glm::vec2 u = b.TexCoords - a.TexCoords, v = c.TexCoords - a.TexCoords;
+      uvArea += fabs(u.x * v.y - u.y * v.x);
+    }
+    if (uvArea > 0.0)
+      uvScale = float(sqrt(area / uvArea));
+  }
 
-  // initializes all the buffer objects/arrays
+  // copies the geometry into the arena of its vertex format
   void setupMesh() {
-    // create buffers/arrays
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-    // load data into vertex buffers
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // A great thing about structs is that their memory layout is sequential for
-    // all its items. The effect is that we can simply pass a pointer to the
-    // struct and it translates perfectly to a glm::vec3/2 array which again
-    // translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-                 &vertices[0], GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-                 &indices[0], GL_STATIC_DRAW);
-
-    // set the vertex attribute pointers
-    // vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void *)offsetof(Vertex, Normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void *)offsetof(Vertex, TexCoords));
-    // vertex tangent
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void *)offsetof(Vertex, Tangent));
-    // vertex bitangent
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void *)offsetof(Vertex, Bitangent));
-    // ids
-    glEnableVertexAttribArray(5);
-    glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex),
-                           (void *)offsetof(Vertex, m_BoneIDs));
-
-    // weights
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void *)offsetof(Vertex, m_Weights));
-    glBindVertexArray(0);
+    vector<CompactVertex> compact;
+    if (format == VERTEX_COMPACT && !packCompactVertices(vertices, compact))
+      format = VERTEX_FULL;
+    arena = &getGeometryArena(format);
+
+    // indices are relative to the mesh's base vertex, so 16 bits are enough
+    // for any mesh with up to 65536 vertices wherever it lands in the arena.
+    // The CPU copy stays 32-bit.
+    vertexCount = vertices.size();
+    indexType = indexTypeFor(vertices.size());
+    // all LOD levels go into one allocation, back to back. Without LODs the
+    // 32-bit indices go up as they are.
+    lods.assign(1, {0, (unsigned int)indices.size()});
+    vector<unsigned int> allIndices;
+    if (!lodIndices.empty()) {
+      allIndices = indices;
+      for (auto &lod : lodIndices) {
+        lods.push_back(
+            {(unsigned int)allIndices.size(), (unsigned int)lod.size()});
+        allIndices.insert(allIndices.end(), lod.begin(), lod.end());
+      }
+    }
+    const vector<unsigned int> &uploadIndices =
+        lodIndices.empty() ? indices : allIndices;
+    vector<uint16_t> shortIndices;
+    const void *indexData = uploadIndices.data();
+    if (indexType == GL_UNSIGNED_SHORT) {
+      shortIndices.assign(uploadIndices.begin(), uploadIndices.end());
+      indexData = shortIndices.data();
+    }
+    const SkinVertex *skinData = skinned ? skin.data() : nullptr;
+    if (format == VERTEX_COMPACT)
+      geometry = arena->allocate(compact.data(), compact.size(), indexData,
+                                 uploadIndices.size(), indexType, skinData);
+    else
+      geometry = arena->allocate(vertices.data(), vertices.size(), indexData,
+                                 uploadIndices.size(), indexType, skinData);
   }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,314 @@
+#include "meshcache.h"
+#include "objloader.h"
+#include "threadpool.h"
+#include "utils.h"
+#include "vertexcodec.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+static const char MESH_CACHE_MAGIC[8] = {'O', 'G', 'L', 'M', 'E', 'S', 'H', 0};
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+uint64_t meshCacheKey(const string &sourcePath, unsigned int importFlags) {
+  MappedFile source;
+  if (!source.open(sourcePath))
+    return 0;
+  uint64_t key = hashBytes(source.data(), source.size());
+  // the materials of an OBJ live in its .mtl files, cached with the meshes
+  if (isObjPath(sourcePath))
+    for (auto &library :
+         objMaterialLibraries(sourcePath, (const char *)source.data(),
+                              source.size())) {
+      MappedFile mtl;
+      if (mtl.open(library))
+        key = hashBytes(mtl.data(), mtl.size(), key);
+      else // so the key changes once it appears
+        key = hashBytes(library.data(), library.size(), key);
+    }
+  uint32_t salt[9] = {importFlags,           MESH_CACHE_VERSION,
+                      sizeof(Vertex),        MESH_OPTIMIZE_ENABLED,
+                      MESH_LOD_LEVELS,       sizeof(Meshlet),
+                      MESHLET_MAX_TRIANGLES, MESHLET_MAX_VERTICES,
+                      BUILTIN_OBJ_LOADER};
+  return hashBytes(salt, sizeof(salt), key);
+}
+
+bool MeshCache::validate(uint64_t key) const {
+  size_t size = file.size();
+  if (size < sizeof(MeshCacheHeader))
+    return false;
+  const MeshCacheHeader *h = header();
+  if (memcmp(h->magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+      h->version != MESH_CACHE_VERSION || h->vertexSize != sizeof(Vertex) ||
+      h->key != key)
+    return false;
+  // every table and array has to lie inside the file
+  auto inside = [&](uint64_t offset, uint64_t bytes) {
+    return offset <= size && bytes <= size - offset;
+  };
+  if (!inside(h->meshOffset, uint64_t(h->meshCount) * sizeof(MeshCacheMesh)) ||
+      !inside(h->materialOffset,
+              uint64_t(h->materialCount) * sizeof(MeshCacheMaterial)) ||
+      !inside(h->textureOffset,
+              uint64_t(h->textureCount) * sizeof(MeshCacheTexture)) ||
+      !inside(h->stringOffset, h->stringBytes))
+    return false;
+  for (unsigned int i = 0; i < h->meshCount; i++) {
+    const MeshCacheMesh &m = meshTable()[i];
+    uint64_t lodIndices = 0;
+    for (unsigned int lod = 0; lod < m.lodCount && lod < MESH_CACHE_MAX_LODS;
+         lod++)
+      lodIndices += m.lodIndexCount[lod];
+    if (m.lodCount == 0 || m.lodCount > MESH_CACHE_MAX_LODS ||
+        lodIndices != m.indexCount || m.materialIndex >= h->materialCount ||
+        !inside(m.vertexOffset, m.vertexBytes) ||
+        !inside(m.indexOffset, m.indexBytes) ||
+        (!m.encoded &&
+         (m.vertexBytes != uint64_t(m.vertexCount) * sizeof(Vertex) ||
+          m.indexBytes != uint64_t(m.indexCount) * sizeof(unsigned int))) ||
+        !inside(m.meshletOffset, uint64_t(m.meshletCount) * sizeof(Meshlet)))
+      return false;
+    // meshlets have to stay within the full detail level
+    const Meshlet *meshlets = this->meshlets(m);
+    for (unsigned int j = 0; j < m.meshletCount; j++)
+      if (uint64_t(meshlets[j].firstIndex) + meshlets[j].indexCount >
+          m.lodIndexCount[0])
+        return false;
+  }
+  const MeshCacheMaterial *materials =
+      reinterpret_cast<const MeshCacheMaterial *>(file.data() +
+                                                  h->materialOffset);
+  for (unsigned int i = 0; i < h->materialCount; i++)
+    if (uint64_t(materials[i].textureFirst) + materials[i].textureCount >
+        h->textureCount)
+      return false;
+  const MeshCacheTexture *textures =
+      reinterpret_cast<const MeshCacheTexture *>(file.data() +
+                                                 h->textureOffset);
+  for (unsigned int i = 0; i < h->textureCount; i++)
+    if (uint64_t(textures[i].typeOffset) + textures[i].typeLength >
+            h->stringBytes ||
+        uint64_t(textures[i].pathOffset) + textures[i].pathLength >
+            h->stringBytes)
+      return false;
+  return true;
+}
+
+bool MeshCache::open(const string &path, uint64_t key) {
+  if (!file.open(path))
+    return false;
+  if (!validate(key)) {
+    file.close();
+    return false;
+  }
+  return true;
+}
+
+bool MeshCache::readVertices(const MeshCacheMesh &m, Vertex *out) const {
+  const unsigned char *data = file.data() + m.vertexOffset;
+  if (m.encoded)
+    return decodeVertexBuffer(out, m.vertexCount, sizeof(Vertex), data,
+                              m.vertexBytes);
+  memcpy(out, data, m.vertexBytes);
+  return true;
+}
+
+bool MeshCache::readIndices(const MeshCacheMesh &m, unsigned int *out) const {
+  const unsigned char *data = file.data() + m.indexOffset;
+  if (m.encoded)
+    return decodeIndexBuffer(out, m.indexCount, data, m.indexBytes);
+  memcpy(out, data, m.indexBytes);
+  return true;
+}
+
+vector<Texture> MeshCache::materialTextures(unsigned int materialIndex) const {
+  const MeshCacheHeader *h = header();
+  const MeshCacheMaterial &material =
+      reinterpret_cast<const MeshCacheMaterial *>(
+          file.data() + h->materialOffset)[materialIndex];
+  const MeshCacheTexture *textures =
+      reinterpret_cast<const MeshCacheTexture *>(file.data() +
+                                                 h->textureOffset);
+  const char *strings =
+      reinterpret_cast<const char *>(file.data() + h->stringOffset);
+
+  vector<Texture> result;
+  for (unsigned int i = 0; i < material.textureCount; i++) {
+    const MeshCacheTexture &t = textures[material.textureFirst + i];
+    Texture texture;
+    texture.id = 0;
+    texture.type.assign(strings + t.typeOffset, t.typeLength);
+    texture.path.assign(strings + t.pathOffset, t.pathLength);
+    result.push_back(texture);
+  }
+  return result;
+}
+
+bool writeMeshCache(const string &path, uint64_t key,
+                    const vector<MeshCacheInput> &meshes,
+                    const vector<vector<Texture>> &materials) {
+  MeshCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+  header.version = MESH_CACHE_VERSION;
+  header.vertexSize = sizeof(Vertex);
+  header.key = key;
+  header.meshCount = meshes.size();
+  header.materialCount = materials.size();
+
+  // flatten materials into the texture table and string table
+  vector<MeshCacheMaterial> materialTable;
+  vector<MeshCacheTexture> textureTable;
+  string strings;
+  for (auto &textures : materials) {
+    MeshCacheMaterial material;
+    material.textureFirst = textureTable.size();
+    material.textureCount = textures.size();
+    for (auto &texture : textures) {
+      MeshCacheTexture t;
+      t.typeOffset = strings.size();
+      t.typeLength = texture.type.size();
+      strings += texture.type;
+      t.pathOffset = strings.size();
+      t.pathLength = texture.path.size();
+      strings += texture.path;
+      textureTable.push_back(t);
+    }
+    materialTable.push_back(material);
+  }
+  header.textureCount = textureTable.size();
+  header.stringBytes = strings.size();
+
+  // lay out the file: header, tables, strings, then aligned mesh data
+  uint64_t offset = sizeof(MeshCacheHeader);
+  header.meshOffset = offset;
+  offset += meshes.size() * sizeof(MeshCacheMesh);
+  header.materialOffset = offset;
+  offset += materialTable.size() * sizeof(MeshCacheMaterial);
+  header.textureOffset = offset;
+  offset += textureTable.size() * sizeof(MeshCacheTexture);
+  header.stringOffset = offset;
+  offset += strings.size();
+
+  // encode every mesh up front, the layout needs the sizes. All LOD levels
+  // go into one index stream.
+  vector<vector<uint8_t>> encodedVertices(meshes.size()),
+      encodedIndices(meshes.size());
+  if (MESH_CACHE_COMPRESSION)
+    getWorkerPool().parallelFor(meshes.size(), [&](size_t i) {
+      const MeshCacheInput &mesh = meshes[i];
+      encodeVertexBuffer(mesh.vertices, mesh.vertexCount, sizeof(Vertex),
+                         encodedVertices[i]);
+      vector<unsigned int> indices(mesh.indices,
+                                   mesh.indices + mesh.indexCount);
+      if (mesh.lodIndices)
+        for (size_t lod = 0;
+             lod < mesh.lodIndices->size() && lod + 1 < MESH_CACHE_MAX_LODS;
+             lod++)
+          indices.insert(indices.end(), (*mesh.lodIndices)[lod].begin(),
+                         (*mesh.lodIndices)[lod].end());
+      encodeIndexBuffer(indices.data(), indices.size(), encodedIndices[i]);
+    });
+
+  vector<MeshCacheMesh> meshTable;
+  for (size_t i = 0; i < meshes.size(); i++) {
+    const MeshCacheInput &mesh = meshes[i];
+    MeshCacheMesh m;
+    memset(&m, 0, sizeof(m));
+    m.materialIndex = mesh.materialIndex;
+    m.vertexCount = mesh.vertexCount;
+    m.indexCount = mesh.indexCount;
+    m.lodCount = 1;
+    m.lodIndexCount[0] = mesh.indexCount;
+    if (mesh.lodIndices)
+      for (auto &lod : *mesh.lodIndices) {
+        if (m.lodCount == MESH_CACHE_MAX_LODS)
+          break;
+        m.lodIndexCount[m.lodCount++] = lod.size();
+        m.indexCount += lod.size();
+      }
+    m.encoded = MESH_CACHE_COMPRESSION;
+    m.vertexBytes = m.encoded ? encodedVertices[i].size()
+                              : uint64_t(mesh.vertexCount) * sizeof(Vertex);
+    m.indexBytes = m.encoded ? encodedIndices[i].size()
+                             : uint64_t(m.indexCount) * sizeof(unsigned int);
+    offset = alignUp(offset, 16);
+    m.vertexOffset = offset;
+    offset += m.vertexBytes;
+    offset = alignUp(offset, 16);
+    m.indexOffset = offset;
+    offset += m.indexBytes;
+    m.meshletCount = mesh.meshlets ? mesh.meshlets->size() : 0;
+    offset = alignUp(offset, 16);
+    m.meshletOffset = offset;
+    offset += uint64_t(m.meshletCount) * sizeof(Meshlet);
+    meshTable.push_back(m);
+  }
+
+  // write to a temporary file first so a crash never leaves a truncated
+  // cache behind that would be mapped on the next start
+  string tmpPath = path + ".tmp";
+  ofstream out(tmpPath, ios::binary | ios::trunc);
+  if (!out) {
+    cout << "::Warning:: Cannot write mesh cache: " << path << endl;
+    return false;
+  }
+  uint64_t written = 0;
+  auto put = [&](const void *data, uint64_t bytes) {
+    out.write(static_cast<const char *>(data), bytes);
+    written += bytes;
+  };
+  auto pad = [&](uint64_t target) {
+    static const char zeros[16] = {};
+    put(zeros, target - written);
+  };
+  put(&header, sizeof(header));
+  put(meshTable.data(), meshTable.size() * sizeof(MeshCacheMesh));
+  put(materialTable.data(), materialTable.size() * sizeof(MeshCacheMaterial));
+  put(textureTable.data(), textureTable.size() * sizeof(MeshCacheTexture));
+  put(strings.data(), strings.size());
+  for (size_t i = 0; i < meshes.size(); i++) {
+    pad(meshTable[i].vertexOffset);
+    if (meshTable[i].encoded) {
+      put(encodedVertices[i].data(), encodedVertices[i].size());
+      pad(meshTable[i].indexOffset);
+      put(encodedIndices[i].data(), encodedIndices[i].size());
+    } else {
+      put(meshes[i].vertices,
+          uint64_t(meshes[i].vertexCount) * sizeof(Vertex));
+      pad(meshTable[i].indexOffset);
+      put(meshes[i].indices,
+          uint64_t(meshes[i].indexCount) * sizeof(unsigned int));
+      for (unsigned int lod = 1; lod < meshTable[i].lodCount; lod++)
+        put((*meshes[i].lodIndices)[lod - 1].data(),
+            uint64_t(meshTable[i].lodIndexCount[lod]) * sizeof(unsigned int));
+    }
+    pad(meshTable[i].meshletOffset);
+    if (meshTable[i].meshletCount)
+      put(meshes[i].meshlets->data(),
+          uint64_t(meshTable[i].meshletCount) * sizeof(Meshlet));
+  }
+  out.close();
+  if (!out) {
+    cout << "::Warning:: Failed writing mesh cache: " << path << endl;
+    std::error_code ec;
+    filesystem::remove(tmpPath, ec);
+    return false;
+  }
+
+  std::error_code ec;
+  filesystem::rename(tmpPath, path, ec);
+  if (ec) {
+    cout << "::Warning:: Cannot replace mesh cache: " << path << endl;
+    filesystem::remove(tmpPath, ec);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,137 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "mesh.h"
+#include "mapped_file.h"
+#include "config.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Bump whenever the layout below, the Vertex struct or what the importers
+// produce changes; old cache files are then rejected and rebuilt from the
+// source model.
+#define MESH_CACHE_VERSION 6
+// LOD levels a cached mesh can hold, full detail included
+#define MESH_CACHE_MAX_LODS 8
+
+// On-disk layout of a processed model. Everything after the header is
+// addressed by byte offsets from the start of the file, and the vertex/index
+// arrays are 16-byte aligned. With MESH_CACHE_COMPRESSION they are stored
+// through vertexcodec.h and decoded on load, otherwise as they are.
+struct MeshCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t vertexSize;
+  uint64_t key;
+  uint32_t meshCount;
+  uint32_t materialCount;
+  uint32_t textureCount;
+  uint32_t stringBytes;
+  uint64_t meshOffset;
+  uint64_t materialOffset;
+  uint64_t textureOffset;
+  uint64_t stringOffset;
+};
+
+// indexCount covers the index arrays of all LOD levels, stored back to back
+// starting with full detail. The meshlets split the full detail level.
+// vertexBytes/indexBytes are the stored sizes, encoded or not.
+struct MeshCacheMesh {
+  uint32_t materialIndex;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t lodCount;
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint32_t lodIndexCount[MESH_CACHE_MAX_LODS];
+  uint32_t meshletCount;
+  uint32_t encoded; // 1 if vertices and indices went through vertexcodec.h
+  uint64_t meshletOffset;
+  uint64_t vertexBytes;
+  uint64_t indexBytes;
+};
+
+struct MeshCacheMaterial {
+  uint32_t textureFirst;
+  uint32_t textureCount;
+};
+
+// type and path are both stored in the string table
+struct MeshCacheTexture {
+  uint32_t typeOffset;
+  uint32_t typeLength;
+  uint32_t pathOffset;
+  uint32_t pathLength;
+};
+
+// A loaded mesh as it goes into / comes out of the cache, before any GL
+// resources exist.
+struct MeshCacheInput {
+  const Vertex *vertices;
+  unsigned int vertexCount;
+  const unsigned int *indices;
+  unsigned int indexCount;
+  unsigned int materialIndex;
+  const vector<vector<unsigned int>> *lodIndices; // levels after the first
+  const vector<Meshlet> *meshlets;
+};
+
+// Read-only view over a mapped cache file.
+class MeshCache {
+public:
+  // maps the file and validates it against the expected key; returns false
+  // (and leaves the cache closed) on any mismatch or corruption.
+  bool open(const string &path, uint64_t key);
+  void close() { file.close(); }
+
+  unsigned int meshCount() const { return header()->meshCount; }
+  const MeshCacheMesh &mesh(unsigned int i) const {
+    return meshTable()[i];
+  }
+  // copy or decode the m.vertexCount vertices / the m.indexCount indices of
+  // all LOD levels. Safe to call for different meshes from several threads.
+  // Return false if encoded data turns out to be corrupt.
+  bool readVertices(const MeshCacheMesh &m, Vertex *out) const;
+  bool readIndices(const MeshCacheMesh &m, unsigned int *out) const;
+  // bytes the mesh arrays take in the file
+  uint64_t storedBytes(const MeshCacheMesh &m) const {
+    return m.vertexBytes + m.indexBytes;
+  }
+  const Meshlet *meshlets(const MeshCacheMesh &m) const {
+    return reinterpret_cast<const Meshlet *>(file.data() + m.meshletOffset);
+  }
+  // texture references (id left at 0) of the given material
+  vector<Texture> materialTextures(unsigned int materialIndex) const;
+
+private:
+  MappedFile file;
+
+  const MeshCacheHeader *header() const {
+    return reinterpret_cast<const MeshCacheHeader *>(file.data());
+  }
+  const MeshCacheMesh *meshTable() const {
+    return reinterpret_cast<const MeshCacheMesh *>(file.data() +
+                                                   header()->meshOffset);
+  }
+  bool validate(uint64_t key) const;
+};
+
+// key of a source model: hash of its bytes (and of the material libraries
+// of an OBJ), the Assimp import flags and the cache format, so any of them
+// changing invalidates the cache.
+uint64_t meshCacheKey(const string &sourcePath, unsigned int importFlags);
+
+inline string meshCachePath(const string &sourcePath) {
+  return sourcePath + MESH_CACHE_EXTENSION;
+}
+
+// materials[i] holds the texture references of material i. With
+// MESH_CACHE_COMPRESSION the meshes are encoded on the worker pool.
+bool writeMeshCache(const string &path, uint64_t key,
+                    const vector<MeshCacheInput> &meshes,
+                    const vector<vector<Texture>> &materials);
+
+#endif
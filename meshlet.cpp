@@ -0,0 +1,64 @@
+#include "meshlet.h"
+
+#include <cmath>
+
+ClusterCulling clusterCulling;
+
+bool CullFrame::visible(const Meshlet &meshlet) const {
+  for (const glm::vec4 &plane : planes)
+    if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w <
+        -meshlet.radius)
+      return false;
+
+  // back-facing if the whole cone of normals points away from every point
+  // of the sphere: the angle between the axis and the view direction has to
+  // exceed 90 degrees by the cone's and the sphere's half angles
+  if (!cones || meshlet.coneCutoff <= 0.f)
+    return true;
+  glm::vec3 toCenter = meshlet.center - eye;
+  float distance = glm::length(toCenter);
+  if (distance <= meshlet.radius)
+    return true;
+  float spread = acosf(meshlet.coneCutoff) + asinf(meshlet.radius / distance);
+  if (spread >= 1.5707963f)
+    return true;
+  return glm::dot(meshlet.coneAxis, toCenter / distance) < sinf(spread);
+}
+
+void ClusterCulling::setView(const glm::mat4 &viewProjection,
+                             const glm::vec3 &eye) {
+  this->eye = eye;
+  // rows of the matrix combine into the clip planes (Gribb & Hartmann)
+  glm::mat4 m = glm::transpose(viewProjection);
+  planes[0] = m[3] + m[0];
+  planes[1] = m[3] - m[0];
+  planes[2] = m[3] + m[1];
+  planes[3] = m[3] - m[1];
+  planes[4] = m[3] + m[2];
+  planes[5] = m[3] - m[2];
+}
+
+bool ClusterCulling::sphereVisible(const glm::vec3 &center,
+                                   float radius) const {
+  // the planes of setView are not normalized
+  for (const glm::vec4 &plane : planes)
+    if (glm::dot(glm::vec3(plane), center) + plane.w <
+        -radius * glm::length(glm::vec3(plane)))
+      return false;
+  return true;
+}
+
+bool ClusterCulling::modelFrame(const glm::mat4 &model,
+                                CullFrame &frame) const {
+  if (!enabled || !active)
+    return false;
+  // a world plane p becomes transpose(model) * p in model space
+  glm::mat4 toModel = glm::transpose(model);
+  for (int i = 0; i < 6; i++) {
+    glm::vec4 plane = toModel * planes[i];
+    frame.planes[i] = plane / glm::length(glm::vec3(plane));
+  }
+  frame.eye = glm::vec3(glm::inverse(model) * glm::vec4(eye, 1.f));
+  frame.cones = cones;
+  return true;
+}
@@ -0,0 +1,52 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include "config.h"
+
+// A cluster of up to MESHLET_MAX_TRIANGLES neighbouring triangles of a mesh,
+// stored as a contiguous range of its full detail indices. Bounds are in
+// model space.
+struct Meshlet {
+  unsigned int firstIndex;
+  unsigned int indexCount;
+  glm::vec3 center;
+  float radius;
+  // every triangle normal n satisfies dot(n, coneAxis) >= coneCutoff
+  glm::vec3 coneAxis;
+  float coneCutoff;
+};
+
+// The culling view moved into one object's model space.
+struct CullFrame {
+  glm::vec3 eye;
+  glm::vec4 planes[6]; // normalized, inside is positive
+  bool cones;          // test the normal cones too
+
+  // false if the meshlet is outside the frustum or faces away entirely
+  bool visible(const Meshlet &meshlet) const;
+};
+
+// The camera meshlets are culled against. Culling only applies while
+// `active`, which Lights::render sets around the G-buffer pass; shadow
+// passes see from the lights and draw everything.
+struct ClusterCulling {
+  bool enabled = MESHLET_CULLING_ENABLED;
+  bool cones = MESHLET_CONE_CULLING;
+  bool active = false;
+  glm::vec3 eye = glm::vec3(0.f);
+  glm::vec4 planes[6];
+
+  // takes the frustum planes out of a world to clip space matrix
+  void setView(const glm::mat4 &viewProjection, const glm::vec3 &eye);
+  // the view in model space of an object; false if culling is off
+  bool modelFrame(const glm::mat4 &model, CullFrame &frame) const;
+  // true if a world-space sphere touches the frustum, whether or not
+  // culling is on
+  bool sphereVisible(const glm::vec3 &center, float radius) const;
+};
+
+extern ClusterCulling clusterCulling;
+
+#endif
@@ -0,0 +1,754 @@
+#include "meshopt.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+using namespace std;
+
+VertexCacheStats analyzeVertexCache(const unsigned int *indices,
+                                    size_t indexCount, size_t vertexCount) {
+  VertexCacheStats stats;
+  stats.triangles = indexCount / 3;
+  // a vertex is in the cache while fewer than VERTEX_CACHE_SIZE misses
+  // happened since it was loaded
+  vector<size_t> loadedAt(vertexCount, SIZE_MAX);
+  for (size_t i = 0; i < indexCount; i++) {
+    unsigned int v = indices[i];
+    if (loadedAt[v] == SIZE_MAX)
+      stats.vertices++;
+    if (loadedAt[v] == SIZE_MAX ||
+        stats.transformed - loadedAt[v] >= VERTEX_CACHE_SIZE) {
+      loadedAt[v] = stats.transformed;
+      stats.transformed++;
+    }
+  }
+  return stats;
+}
+
+namespace {
+// triangles of every vertex, as a compact adjacency list: those of vertex v
+// are adjacency[offsets[v]] up to adjacency[offsets[v + 1]]
+void buildTriangleAdjacency(const unsigned int *indices, size_t indexCount,
+                            size_t vertexCount, vector<unsigned int> &offsets,
+                            vector<unsigned int> &adjacency) {
+  offsets.assign(vertexCount + 1, 0);
+  for (size_t i = 0; i < indexCount; i++)
+    offsets[indices[i] + 1]++;
+  for (size_t v = 0; v < vertexCount; v++)
+    offsets[v + 1] += offsets[v];
+  adjacency.resize(indexCount);
+  vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < indexCount; i++)
+    adjacency[fill[indices[i]]++] = i / 3;
+}
+
+const int CACHE_SIZE = VERTEX_CACHE_OPTIMIZE_SIZE;
+
+float vertexScore(int cachePosition, unsigned int remaining) {
+  if (remaining == 0)
+    return -1.0f; // nothing left to draw with this vertex
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // the last triangle's vertices get a fixed score, otherwise the
+      // algorithm would favour strips over fans
+      score = 0.75f;
+    } else {
+      float scaler = 1.0f / (CACHE_SIZE - 3);
+      score = powf(1.0f - (cachePosition - 3) * scaler, 1.5f);
+    }
+  }
+  // boost vertices with few triangles left so they get finished off
+  return score + 2.0f / sqrtf(float(remaining));
+}
+} // namespace
+
+void optimizeVertexCache(unsigned int *indices, size_t indexCount,
+                         size_t vertexCount) {
+  size_t triangleCount = indexCount / 3;
+  if (triangleCount < 2)
+    return;
+
+  vector<unsigned int> offsets, adjacency;
+  buildTriangleAdjacency(indices, indexCount, vertexCount, offsets, adjacency);
+  vector<unsigned int> remaining(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++)
+    remaining[v] = offsets[v + 1] - offsets[v];
+
+  vector<float> vScore(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++)
+    vScore[v] = vertexScore(-1, remaining[v]);
+  vector<float> tScore(triangleCount);
+  vector<bool> emitted(triangleCount, false);
+  for (size_t t = 0; t < triangleCount; t++)
+    tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] +
+                vScore[indices[t * 3 + 2]];
+
+  vector<unsigned int> output;
+  output.reserve(indexCount);
+  unsigned int cache[CACHE_SIZE + 3];
+  int cacheCount = 0;
+  size_t scanCursor = 0;
+  long best = 0;
+  for (size_t t = 1; t < triangleCount; t++)
+    if (tScore[t] > tScore[best])
+      best = t;
+
+  while (best >= 0) {
+    emitted[best] = true;
+    const unsigned int *tri = &indices[best * 3];
+    output.insert(output.end(), tri, tri + 3);
+
+    // take the triangle out of its vertices' adjacency lists
+    for (int k = 0; k < 3; k++) {
+      unsigned int v = tri[k];
+      unsigned int *begin = &adjacency[offsets[v]];
+      unsigned int *end = begin + remaining[v];
+      *find(begin, end, (unsigned int)best) = end[-1];
+      remaining[v]--;
+    }
+
+    // move the triangle's vertices to the front of the LRU cache
+    unsigned int newCache[CACHE_SIZE + 3];
+    int newCount = 0;
+    for (int k = 0; k < 3; k++)
+      newCache[newCount++] = tri[k];
+    for (int i = 0; i < cacheCount; i++) {
+      unsigned int v = cache[i];
+      if (v != tri[0] && v != tri[1] && v != tri[2])
+        newCache[newCount++] = v;
+    }
+    // rescore everything that was or is in the cache, and pick the best
+    // triangle among their neighbours
+    best = -1;
+    float bestScore = -1.0f;
+    for (int i = 0; i < newCount; i++) {
+      unsigned int v = newCache[i];
+      vScore[v] = vertexScore(i < CACHE_SIZE ? i : -1, remaining[v]);
+    }
+    for (int i = 0; i < newCount; i++) {
+      unsigned int v = newCache[i];
+      for (unsigned int j = 0; j < remaining[v]; j++) {
+        unsigned int t = adjacency[offsets[v] + j];
+        tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] +
+                    vScore[indices[t * 3 + 2]];
+        if (tScore[t] > bestScore) {
+          bestScore = tScore[t];
+          best = t;
+        }
+      }
+    }
+    cacheCount = min(newCount, CACHE_SIZE);
+    memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+
+    // nothing connected to the cache is left, continue with the next
+    // triangle in input order
+    if (best < 0) {
+      while (scanCursor < triangleCount && emitted[scanCursor])
+        scanCursor++;
+      if (scanCursor < triangleCount)
+        best = scanCursor;
+    }
+  }
+  memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+void optimizeOverdraw(unsigned int *indices, size_t indexCount,
+                      const Vertex *vertices, size_t vertexCount) {
+  size_t triangleCount = indexCount / 3;
+  if (triangleCount < 2)
+    return;
+
+  // cluster boundaries are the triangles missing all three vertices: the
+  // cache was flushed there anyway, so clusters can move freely
+  vector<size_t> clusterStart;
+  {
+    vector<size_t> loadedAt(vertexCount, SIZE_MAX);
+    size_t transformed = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+      int misses = 0;
+      for (int k = 0; k < 3; k++) {
+        unsigned int v = indices[t * 3 + k];
+        if (loadedAt[v] == SIZE_MAX ||
+            transformed - loadedAt[v] >= VERTEX_CACHE_SIZE) {
+          loadedAt[v] = transformed++;
+          misses++;
+        }
+      }
+      if (t == 0 || misses == 3)
+        clusterStart.push_back(t);
+    }
+  }
+  if (clusterStart.size() < 2)
+    return;
+  clusterStart.push_back(triangleCount);
+
+  // mesh centroid, area weighted
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+  size_t clusterCount = clusterStart.size() - 1;
+  vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+  vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+  vector<float> clusterArea(clusterCount, 0.0f);
+  for (size_t c = 0; c < clusterCount; c++) {
+    for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+      glm::vec3 a = vertices[indices[t * 3]].Position;
+      glm::vec3 b = vertices[indices[t * 3 + 1]].Position;
+      glm::vec3 d = vertices[indices[t * 3 + 2]].Position;
+      glm::vec3 n = glm::cross(b - a, d - a); // length is twice the area
+      float area = glm::length(n);
+      clusterCentroid[c] += (a + b + d) * (area / 3.0f);
+      clusterNormal[c] += n;
+      clusterArea[c] += area;
+    }
+    meshCentroid += clusterCentroid[c];
+    meshArea += clusterArea[c];
+  }
+  if (meshArea <= 0.0f)
+    return;
+  meshCentroid /= meshArea;
+
+  // clusters that face away from the centre are likely in front of the rest
+  vector<float> sortKey(clusterCount);
+  vector<size_t> order(clusterCount);
+  for (size_t c = 0; c < clusterCount; c++) {
+    order[c] = c;
+    if (clusterArea[c] <= 0.0f) {
+      sortKey[c] = 0.0f;
+      continue;
+    }
+    glm::vec3 centroid = clusterCentroid[c] / clusterArea[c];
+    float normalLength = glm::length(clusterNormal[c]);
+    sortKey[c] = normalLength > 0.0f
+                     ? glm::dot(centroid - meshCentroid,
+                                clusterNormal[c] / normalLength)
+                     : 0.0f;
+  }
+  stable_sort(order.begin(), order.end(),
+              [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+  vector<unsigned int> sorted;
+  sorted.reserve(indexCount);
+  for (size_t c : order)
+    sorted.insert(sorted.end(), indices + clusterStart[c] * 3,
+                  indices + clusterStart[c + 1] * 3);
+
+  float cacheAcmr = analyzeVertexCache(indices, indexCount, vertexCount).acmr();
+  float sortedAcmr =
+      analyzeVertexCache(sorted.data(), indexCount, vertexCount).acmr();
+  if (sortedAcmr <= cacheAcmr * OVERDRAW_ACMR_THRESHOLD)
+    memcpy(indices, sorted.data(), indexCount * sizeof(unsigned int));
+}
+
+size_t optimizeVertexFetch(vector<Vertex> &vertices,
+                           vector<unsigned int> &indices,
+                           vector<SkinVertex> *skin) {
+  bool skinned = skin && !skin->empty();
+  vector<unsigned int> remap(vertices.size(), UINT32_MAX);
+  vector<Vertex> fetchOrder;
+  vector<SkinVertex> skinOrder;
+  fetchOrder.reserve(vertices.size());
+  if (skinned)
+    skinOrder.reserve(vertices.size());
+  for (auto &index : indices) {
+    if (remap[index] == UINT32_MAX) {
+      remap[index] = fetchOrder.size();
+      fetchOrder.push_back(vertices[index]);
+      if (skinned)
+        skinOrder.push_back((*skin)[index]);
+    }
+    index = remap[index];
+  }
+  vertices.swap(fetchOrder);
+  if (skinned)
+    skin->swap(skinOrder);
+  return vertices.size();
+}
+
+namespace {
+// symmetric 4x4 matrix summing squared distances to a set of planes
+struct Quadric {
+  double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+  double a11 = 0, a12 = 0, a13 = 0;
+  double a22 = 0, a23 = 0;
+  double a33 = 0;
+
+  static Quadric plane(double a, double b, double c, double d) {
+    Quadric q;
+    q.a00 = a * a, q.a01 = a * b, q.a02 = a * c, q.a03 = a * d;
+    q.a11 = b * b, q.a12 = b * c, q.a13 = b * d;
+    q.a22 = c * c, q.a23 = c * d;
+    q.a33 = d * d;
+    return q;
+  }
+  void add(const Quadric &q) {
+    a00 += q.a00, a01 += q.a01, a02 += q.a02, a03 += q.a03;
+    a11 += q.a11, a12 += q.a12, a13 += q.a13;
+    a22 += q.a22, a23 += q.a23;
+    a33 += q.a33;
+  }
+  double error(const glm::vec3 &p) const {
+    double x = p.x, y = p.y, z = p.z;
+    double e = a00 * x * x + a11 * y * y + a22 * z * z + a33 +
+               2 * (a01 * x * y + a02 * x * z + a03 * x + a12 * y * z +
+                    a13 * y + a23 * z);
+    return e > 0 ? e : 0;
+  }
+};
+
+struct Collapse {
+  double cost;
+  unsigned int from, to;
+};
+
+uint64_t edgeKey(unsigned int a, unsigned int b) {
+  return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+} // namespace
+
+float simplifyMesh(const vector<Vertex> &vertices,
+                   const vector<unsigned int> &indices, size_t targetIndexCount,
+                   float maxError, vector<unsigned int> &result) {
+  size_t vertexCount = vertices.size();
+
+  // Vertices equal in position, normal and UV are one vertex the importer
+  // split (unwelded input has three per triangle); the simplifier works on
+  // the first of each, so only real seams count as wedges below
+  vector<unsigned int> canonical(vertexCount);
+  {
+    struct Attributes {
+      glm::vec3 position, normal;
+      glm::vec2 uv;
+      bool operator==(const Attributes &o) const {
+        return position == o.position && normal == o.normal && uv == o.uv;
+      }
+    };
+    struct AttributesHash {
+      size_t operator()(const Attributes &a) const {
+        uint32_t bits[8];
+        memcpy(bits, &a.position, 12);
+        memcpy(bits + 3, &a.normal, 12);
+        memcpy(bits + 6, &a.uv, 8);
+        size_t h = 0;
+        for (uint32_t b : bits)
+          h = h * 73856093u ^ b;
+        return h;
+      }
+    };
+    unordered_map<Attributes, unsigned int, AttributesHash> unique;
+    unique.reserve(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+      const Vertex &vertex = vertices[v];
+      canonical[v] =
+          unique.emplace(Attributes{vertex.Position, vertex.Normal,
+                                    vertex.TexCoords},
+                         unsigned(v))
+              .first->second;
+    }
+  }
+  result.resize(indices.size());
+  for (size_t i = 0; i < indices.size(); i++)
+    result[i] = canonical[indices[i]];
+
+  // vertices sharing a position are wedges of one point
+  vector<unsigned int> point(vertexCount);
+  vector<unsigned int> wedges;
+  {
+    struct PositionHash {
+      size_t operator()(const glm::vec3 &p) const {
+        uint32_t bits[3];
+        memcpy(bits, &p, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^
+               (bits[2] * 83492791u);
+      }
+    };
+    unordered_map<glm::vec3, unsigned int, PositionHash> points;
+    points.reserve(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+      auto it = points.emplace(vertices[v].Position, points.size()).first;
+      point[v] = it->second;
+    }
+    wedges.assign(points.size(), 0);
+    for (size_t v = 0; v < vertexCount; v++)
+      if (canonical[v] == v)
+        wedges[point[v]]++;
+  }
+
+  // seams and open borders stay where they are
+  vector<bool> locked(vertexCount, false);
+  {
+    unordered_map<uint64_t, unsigned int> edgeUse;
+    edgeUse.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i += 3)
+      for (int k = 0; k < 3; k++)
+        edgeUse[edgeKey(point[result[i + k]],
+                        point[result[i + (k + 1) % 3]])]++;
+    vector<bool> border(wedges.size(), false);
+    for (auto &edge : edgeUse)
+      if (edge.second == 1)
+        border[edge.first >> 32] = border[edge.first & 0xffffffff] = true;
+    for (size_t v = 0; v < vertexCount; v++)
+      locked[v] = wedges[point[v]] > 1 || border[point[v]];
+  }
+
+  vector<Quadric> quadrics(wedges.size());
+  for (size_t i = 0; i < result.size(); i += 3) {
+    glm::vec3 p0 = vertices[result[i]].Position;
+    glm::vec3 p1 = vertices[result[i + 1]].Position;
+    glm::vec3 p2 = vertices[result[i + 2]].Position;
+    glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+    float length = glm::length(n);
+    if (length == 0.0f)
+      continue;
+    n /= length;
+    Quadric q = Quadric::plane(n.x, n.y, n.z, -glm::dot(n, p0));
+    for (int k = 0; k < 3; k++)
+      quadrics[point[result[i + k]]].add(q);
+  }
+
+  double errorLimit = double(maxError) * maxError;
+  double worstError = 0;
+  vector<unsigned int> remap(vertexCount);
+  vector<bool> touched(vertexCount);
+  vector<unsigned int> offsets, adjacency;
+  vector<Collapse> collapses;
+  while (result.size() > targetIndexCount) {
+    // triangles around every vertex for this pass
+    buildTriangleAdjacency(result.data(), result.size(), vertexCount, offsets,
+                           adjacency);
+
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3)
+      for (int k = 0; k < 3; k++) {
+        unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+        for (int dir = 0; dir < 2; dir++, swap(a, b)) {
+          if (locked[a])
+            continue;
+          Quadric q = quadrics[point[a]];
+          q.add(quadrics[point[b]]);
+          collapses.push_back({q.error(vertices[b].Position), a, b});
+        }
+      }
+    sort(collapses.begin(), collapses.end(),
+         [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+    for (size_t v = 0; v < vertexCount; v++)
+      remap[v] = v;
+    fill(touched.begin(), touched.end(), false);
+    size_t triangles = result.size() / 3, targetTriangles = targetIndexCount / 3;
+    size_t performed = 0;
+    for (auto &c : collapses) {
+      if (c.cost > errorLimit || triangles <= targetTriangles)
+        break;
+      if (touched[c.from] || touched[c.to])
+        continue;
+      // reject collapses that would flip or badly skew a triangle
+      glm::vec3 target = vertices[c.to].Position;
+      bool valid = true;
+      unsigned int removed = 0;
+      for (unsigned int j = offsets[c.from]; j < offsets[c.from + 1]; j++) {
+        const unsigned int *tri = &result[adjacency[j] * 3];
+        if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+          removed++;
+          continue;
+        }
+        glm::vec3 p[3], q[3];
+        for (int k = 0; k < 3; k++) {
+          p[k] = vertices[tri[k]].Position;
+          q[k] = tri[k] == c.from ? target : p[k];
+        }
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+        if (glm::dot(before, after) <=
+            0.25f * glm::length(before) * glm::length(after)) {
+          valid = false;
+          break;
+        }
+      }
+      if (!valid)
+        continue;
+
+      remap[c.from] = c.to;
+      quadrics[point[c.to]].add(quadrics[point[c.from]]);
+      worstError = max(worstError, c.cost);
+      // the neighbourhood changed, leave it alone for the rest of the pass
+      for (unsigned int j = offsets[c.from]; j < offsets[c.from + 1]; j++) {
+        const unsigned int *tri = &result[adjacency[j] * 3];
+        touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+      }
+      triangles -= removed;
+      performed++;
+    }
+    if (!performed)
+      break;
+
+    // apply the pass and drop the triangles that collapsed to nothing
+    size_t write = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      unsigned int a = remap[result[i]], b = remap[result[i + 1]],
+                   c = remap[result[i + 2]];
+      if (point[a] == point[b] || point[b] == point[c] || point[a] == point[c])
+        continue;
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    result.resize(write);
+  }
+  return float(sqrt(worstError));
+}
+
+void generateMeshLods(MeshData &data, unsigned int levels, float maxError,
+                      size_t minTriangles) {
+  data.lodIndices.clear();
+  if (data.indices.size() / 3 < minTriangles || data.vertices.empty())
+    return;
+  glm::vec3 lo = data.vertices[0].Position, hi = lo;
+  for (auto &v : data.vertices) {
+    lo = glm::min(lo, v.Position);
+    hi = glm::max(hi, v.Position);
+  }
+  float radius = glm::length(hi - lo) * 0.5f;
+
+  const vector<unsigned int> *previous = &data.indices;
+  for (unsigned int level = 0; level < levels; level++) {
+    vector<unsigned int> lod;
+    size_t target = previous->size() / 6 * 3;
+    simplifyMesh(data.vertices, *previous, target, maxError * radius, lod);
+    if (lod.size() > previous->size() * 85 / 100)
+      break;
+    optimizeVertexCache(lod.data(), lod.size(), data.vertices.size());
+    data.lodIndices.push_back(std::move(lod));
+    previous = &data.lodIndices.back();
+  }
+}
+
+void buildMeshlets(MeshData &data, size_t maxTriangles, size_t maxVertices) {
+  data.meshlets.clear();
+  const vector<unsigned int> &indices = data.indices;
+  size_t triangleCount = indices.size() / 3;
+  size_t vertexCount = data.vertices.size();
+  if (triangleCount == 0)
+    return;
+
+  vector<unsigned int> offsets, adjacency;
+  buildTriangleAdjacency(indices.data(), indices.size(), vertexCount, offsets,
+                         adjacency);
+
+  vector<glm::vec3> normals(triangleCount);
+  for (size_t t = 0; t < triangleCount; t++) {
+    glm::vec3 a = data.vertices[indices[t * 3]].Position;
+    glm::vec3 b = data.vertices[indices[t * 3 + 1]].Position;
+    glm::vec3 c = data.vertices[indices[t * 3 + 2]].Position;
+    glm::vec3 n = glm::cross(b - a, c - a);
+    float length = glm::length(n);
+    normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+  }
+
+  // stamps mark membership in the meshlet being built, so nothing has to be
+  // cleared between meshlets
+  vector<bool> used(triangleCount, false);
+  vector<unsigned int> vertexStamp(vertexCount, UINT32_MAX);
+  vector<unsigned int> candidateStamp(triangleCount, UINT32_MAX);
+  vector<unsigned int> reordered;
+  reordered.reserve(indices.size());
+  vector<unsigned int> triangles, candidates;
+  size_t scanCursor = 0;
+
+  for (unsigned int id = 0; scanCursor < triangleCount; id++) {
+    triangles.clear();
+    candidates.clear();
+    size_t meshletVertices = 0;
+    glm::vec3 normalSum(0.0f);
+    auto newVertices = [&](size_t t) {
+      size_t count = 0;
+      for (int k = 0; k < 3; k++)
+        count += vertexStamp[indices[t * 3 + k]] != id;
+      return count;
+    };
+    auto add = [&](size_t t) {
+      used[t] = true;
+      triangles.push_back(t);
+      normalSum += normals[t];
+      for (int k = 0; k < 3; k++) {
+        unsigned int v = indices[t * 3 + k];
+        if (vertexStamp[v] != id) {
+          vertexStamp[v] = id;
+          meshletVertices++;
+        }
+        for (unsigned int i = offsets[v]; i < offsets[v + 1]; i++) {
+          unsigned int neighbour = adjacency[i];
+          if (!used[neighbour] && candidateStamp[neighbour] != id) {
+            candidateStamp[neighbour] = id;
+            candidates.push_back(neighbour);
+          }
+        }
+      }
+    };
+
+    while (scanCursor < triangleCount && used[scanCursor])
+      scanCursor++;
+    if (scanCursor == triangleCount)
+      break;
+    add(scanCursor);
+
+    while (triangles.size() < maxTriangles) {
+      // the neighbour reusing most vertices, ties going to the one that
+      // bends the normal cone least
+      size_t best = SIZE_MAX;
+      float bestScore = -FLT_MAX;
+      glm::vec3 axis = glm::length(normalSum) > 0.0f
+                           ? glm::normalize(normalSum)
+                           : glm::vec3(0.0f);
+      size_t write = 0;
+      for (size_t i = 0; i < candidates.size(); i++) {
+        unsigned int t = candidates[i];
+        if (used[t])
+          continue;
+        candidates[write++] = t;
+        size_t fresh = newVertices(t);
+        if (meshletVertices + fresh > maxVertices)
+          continue;
+        float score = float(3 - fresh) + 0.5f * glm::dot(normals[t], axis);
+        if (score > bestScore) {
+          bestScore = score;
+          best = t;
+        }
+      }
+      candidates.resize(write);
+      // a small piece that ran out of neighbours takes the next triangle in
+      // cache order rather than ending as a tiny meshlet
+      if (best == SIZE_MAX && triangles.size() < maxTriangles / 4) {
+        while (scanCursor < triangleCount && used[scanCursor])
+          scanCursor++;
+        if (scanCursor < triangleCount &&
+            meshletVertices + newVertices(scanCursor) <= maxVertices)
+          best = scanCursor;
+      }
+      if (best == SIZE_MAX)
+        break;
+      add(best);
+    }
+
+    // triangles were picked in growth order; emit them in cache order
+    sort(triangles.begin(), triangles.end());
+    Meshlet meshlet;
+    meshlet.firstIndex = reordered.size();
+    meshlet.indexCount = triangles.size() * 3;
+    glm::vec3 lo = data.vertices[indices[triangles[0] * 3]].Position, hi = lo;
+    for (unsigned int t : triangles)
+      for (int k = 0; k < 3; k++) {
+        unsigned int v = indices[t * 3 + k];
+        reordered.push_back(v);
+        lo = glm::min(lo, data.vertices[v].Position);
+        hi = glm::max(hi, data.vertices[v].Position);
+      }
+    meshlet.center = (lo + hi) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (unsigned int t : triangles)
+      for (int k = 0; k < 3; k++)
+        meshlet.radius =
+            max(meshlet.radius,
+                glm::length(data.vertices[indices[t * 3 + k]].Position -
+                            meshlet.center));
+
+    // the cone axis is the mean normal; degenerate triangles don't count
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = -1.0f; // never culled
+    float axisLength = glm::length(normalSum);
+    if (axisLength > 0.0f) {
+      meshlet.coneAxis = normalSum / axisLength;
+      float cutoff = 1.0f;
+      for (unsigned int t : triangles)
+        if (normals[t] != glm::vec3(0.0f))
+          cutoff = min(cutoff, glm::dot(normals[t], meshlet.coneAxis));
+      meshlet.coneCutoff = cutoff;
+    }
+    data.meshlets.push_back(meshlet);
+  }
+  data.indices.swap(reordered);
+}
+
+void mergeMeshes(vector<MeshData> &meshes, const vector<unsigned int> &groups) {
+  vector<MeshData> merged;
+  unordered_map<unsigned int, size_t> slot; // group -> index in merged
+  vector<vector<size_t>> members;
+  for (size_t i = 0; i < meshes.size(); i++) {
+    auto it = slot.find(groups[i]);
+    if (it == slot.end()) {
+      it = slot.emplace(groups[i], members.size()).first;
+      members.emplace_back();
+    }
+    members[it->second].push_back(i);
+  }
+
+  for (auto &group : members) {
+    if (group.size() == 1) {
+      merged.push_back(std::move(meshes[group[0]]));
+      continue;
+    }
+    MeshData batch;
+    batch.materialIndex = meshes[group[0]].materialIndex;
+    batch.sourceMeshes = 0;
+    size_t vertexCount = 0, indexCount = 0, levels = 0;
+    for (size_t i : group) {
+      vertexCount += meshes[i].vertices.size();
+      indexCount += meshes[i].indices.size();
+      levels = max(levels, meshes[i].lodIndices.size());
+    }
+    batch.vertices.reserve(vertexCount);
+    if (!meshes[group[0]].skin.empty())
+      batch.skin.reserve(vertexCount);
+    batch.indices.reserve(indexCount);
+    batch.lodIndices.resize(levels);
+    // meshlets have to cover every index, or culled draws would lose the
+    // meshes without them
+    bool meshlets = true;
+    for (size_t i : group)
+      meshlets = meshlets &&
+                 (!meshes[i].meshlets.empty() || meshes[i].indices.empty());
+    for (size_t i : group) {
+      MeshData &mesh = meshes[i];
+      unsigned int baseVertex = batch.vertices.size();
+      unsigned int baseIndex = batch.indices.size();
+      batch.vertices.insert(batch.vertices.end(), mesh.vertices.begin(),
+                            mesh.vertices.end());
+      batch.skin.insert(batch.skin.end(), mesh.skin.begin(), mesh.skin.end());
+      for (unsigned int index : mesh.indices)
+        batch.indices.push_back(index + baseVertex);
+      for (size_t lod = 0; lod < levels; lod++) {
+        const vector<unsigned int> &source =
+            mesh.lodIndices.empty()
+                ? mesh.indices
+                : mesh.lodIndices[min(lod, mesh.lodIndices.size() - 1)];
+        for (unsigned int index : source)
+          batch.lodIndices[lod].push_back(index + baseVertex);
+      }
+      if (meshlets)
+        for (Meshlet meshlet : mesh.meshlets) {
+          meshlet.firstIndex += baseIndex;
+          batch.meshlets.push_back(meshlet);
+        }
+      batch.sourceMeshes += mesh.sourceMeshes;
+      // release the source right away, the batch holds a copy
+      mesh = MeshData();
+    }
+    merged.push_back(std::move(batch));
+  }
+  meshes.swap(merged);
+}
+
+void optimizeMesh(MeshData &data, VertexCacheStats &before,
+                  VertexCacheStats &after) {
+  size_t vertexCount = data.vertices.size();
+  before = analyzeVertexCache(data.indices.data(), data.indices.size(),
+                              vertexCount);
+  optimizeVertexCache(data.indices.data(), data.indices.size(), vertexCount);
+  optimizeOverdraw(data.indices.data(), data.indices.size(),
+                   data.vertices.data(), vertexCount);
+  optimizeVertexFetch(data.vertices, data.indices, &data.skin);
+  after = analyzeVertexCache(data.indices.data(), data.indices.size(),
+                             data.vertices.size());
+}
@@ -0,0 +1,95 @@
+#ifndef MESHOPT_H
+#define MESHOPT_H
+
+#include "mesh.h"
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+// FIFO size used to estimate how well an index order uses the GPU's
+// post-transform cache. Real hardware varies; 16 is a safe middle ground.
+#define VERTEX_CACHE_SIZE 16
+// size of the LRU cache the reordering optimizes for
+#define VERTEX_CACHE_OPTIMIZE_SIZE 32
+// the overdraw pass may cost at most this much ACMR over the cache order
+#define OVERDRAW_ACMR_THRESHOLD 1.05f
+
+// Post-transform cache efficiency of an index buffer:
+// ACMR - vertices transformed per triangle (0.5 is ideal on big grids, 3 is
+//        the worst case),
+// ATVR - vertices transformed per referenced vertex (1 is ideal).
+struct VertexCacheStats {
+  size_t triangles = 0;
+  size_t vertices = 0; // referenced vertices
+  size_t transformed = 0;
+
+  float acmr() const { return triangles ? float(transformed) / triangles : 0; }
+  float atvr() const { return vertices ? float(transformed) / vertices : 0; }
+  void add(const VertexCacheStats &other) {
+    triangles += other.triangles;
+    vertices += other.vertices;
+    transformed += other.transformed;
+  }
+};
+
+// simulates a FIFO cache of VERTEX_CACHE_SIZE entries over a triangle list
+VertexCacheStats analyzeVertexCache(const unsigned int *indices,
+                                    size_t indexCount, size_t vertexCount);
+
+// reorders triangles for post-transform cache reuse (Forsyth's linear-speed
+// vertex cache optimisation)
+void optimizeVertexCache(unsigned int *indices, size_t indexCount,
+                         size_t vertexCount);
+
+// Splits a cache-optimized triangle list into clusters at cache flushes and
+// sorts the clusters so outward-facing ones come first, which approximates a
+// front-to-back order from most view directions. Keeps the cache order if the
+// result costs more than OVERDRAW_ACMR_THRESHOLD in ACMR.
+void optimizeOverdraw(unsigned int *indices, size_t indexCount,
+                      const Vertex *vertices, size_t vertexCount);
+
+// renumbers vertices in first-use order so they are fetched sequentially,
+// dropping unreferenced ones. A non-empty skin is reordered along with them.
+// Returns the new vertex count.
+size_t optimizeVertexFetch(vector<Vertex> &vertices,
+                           vector<unsigned int> &indices,
+                           vector<SkinVertex> *skin = nullptr);
+
+// Quadric error edge collapse. Builds an index buffer with at most
+// targetIndexCount indices over the same vertices, collapsing vertices onto
+// their neighbours while the error stays below maxError (a distance, in
+// model units). Vertices on borders and on UV/normal seams (one position,
+// several normals or UVs) never move, so the silhouette and texture mapping
+// are kept. Duplicate vertices are merged first, so unwelded input works.
+// Returns the error of the result.
+float simplifyMesh(const vector<Vertex> &vertices,
+                   const vector<unsigned int> &indices, size_t targetIndexCount,
+                   float maxError, vector<unsigned int> &result);
+
+// fills data.lodIndices with up to `levels` simplified index buffers, each
+// aiming at half the triangles of the previous one. Stops early once a level
+// barely shrinks.
+void generateMeshLods(MeshData &data, unsigned int levels, float maxError,
+                      size_t minTriangles);
+
+// Splits the full detail triangles of data into meshlets of at most
+// maxTriangles triangles and maxVertices vertices, grown greedily over shared
+// vertices with a preference for similar normals. Reorders data.indices so
+// every meshlet is a contiguous range, keeping the cache-optimized triangle
+// order within each, and fills data.meshlets with their bounds and cones.
+void buildMeshlets(MeshData &data, size_t maxTriangles, size_t maxVertices);
+
+// Merges meshes that have the same group id into one mesh, placed where the
+// first of them was. Indices, LOD levels and meshlets are rebased onto the
+// merged vertices; a mesh with fewer LOD levels than its group adds its
+// coarsest one to the levels it lacks. Skins are concatenated, so a group
+// must be all skinned or all static.
+void mergeMeshes(vector<MeshData> &meshes, const vector<unsigned int> &groups);
+
+// runs all three passes on a triangle mesh and reports the cache statistics
+// of the original and the final index order
+void optimizeMesh(MeshData &data, VertexCacheStats &before,
+                  VertexCacheStats &after);
+
+#endif
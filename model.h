@@ -12,51 +12,361 @@
 #include <assimp/postprocess.h>
 
 #include "mesh.h"
+#include "meshcache.h"
+#include "meshopt.h"
 #include "shader_s.h"
 #include "debug.h"
+#include "config.h"
+#include "threadpool.h"
+#include "texture_loader.h"
+#include "texture_registry.h"
+#include "texture_array.h"
+#include "texture_streamer.h"
+#include "lod.h"
+#include "model_loader.h"
+#include "animation.h"
+#include "skinning.h"
+#include "gltf.h"
+#include "objloader.h"
+#include "utils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
+#include <memory>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory,
-                             bool gamma = false);
+// CPU side of a loaded model: everything that exists before GL resources are
+// created, so it can be built on a worker thread.
+struct ModelData {
+  vector<MeshData> meshes;
+  // texture references (id left at 0) of every material the meshes use
+  map<unsigned int, vector<Texture>> materials;
+  // textureSourceHash of every referenced file, by path as in materials.
+  // Hashed here so the texture registry can share identical files without
+  // reading them on the GL thread.
+  unordered_map<string, uint64_t> textureHashes;
+  Skeleton skeleton; // joints of the skinned meshes and the animations
+  // bounding sphere of all meshes in model space
+  glm::vec3 boundsCenter = glm::vec3(0.f);
+  float boundsRadius = 0.f;
+};
 
 class Model {
 public:
   // model data
-  vector<Texture>
-      textures_loaded; // stores all the textures loaded so far, optimization to
-                       // make sure textures aren't loaded more than once.
+  vector<unsigned int>
+      textures_loaded; // registry references held by this model, released
+                       // again when the model goes away.
   vector<Mesh> meshes;
+  vector<unsigned int> textureArrays; // owned, see packTextures
+  vector<unsigned int> meshMaterials; // assimp material index of each mesh
   string directory;
   bool gammaCorrection;
+  VertexFormat vertexFormat; // GPU layout requested for the meshes
+  GeometryResidency residency; // CPU geometry the meshes keep after upload
+  Skeleton skeleton; // empty unless the model has skinned meshes
+  // set instead of meshes for glTF files the native loader took
+  unique_ptr<GltfScene> gltf;
+  // bounding sphere of all meshes in model space, for LOD selection
+  glm::vec3 boundsCenter = glm::vec3(0.f);
+  float boundsRadius = 0.f;
+
+  // constructor, expects a filepath to a 3D model. An async model returns
+  // right away: it is imported on the worker pool and its meshes are created
+  // by ModelLoader::update() over the next frames. It draws nothing until
+  // ready(). glTF files go through the native loader, which only maps and
+  // uploads, so they are always ready at once.
+  Model(string const &path, bool flipUVs = true, bool gamma = true,
+        VertexFormat format = DEFAULT_VERTEX_FORMAT,
+        GeometryResidency residency = DEFAULT_GEOMETRY_RESIDENCY,
+        bool async = false)
+      : gammaCorrection(gamma), vertexFormat(format), residency(residency) {
+    cout << "Start loading model from: " + path << endl;
+    // retrieve the directory path of the filepath
+    directory = path.substr(0, path.find_last_of('/'));
+    if (NATIVE_GLTF_LOADER && GltfScene::handles(path)) {
+      auto scene = make_unique<GltfScene>();
+      if (scene->load(path)) {
+        boundsCenter = scene->boundsCenter;
+        boundsRadius = scene->boundsRadius;
+        gltf = std::move(scene);
+        return;
+      }
+      cout << "::Warning:: Falling back to Assimp for " << path << endl;
+    }
+    pending = make_shared<PendingLoad>();
+    pending->path = path;
+    pending->start = chrono::steady_clock::now();
+    if (!async) {
+      importModel(path, flipUVs, pending->data);
+      createMeshes(SIZE_MAX);
+      return;
+    }
+    // the job only holds the load state, so the model may go away first
+    shared_ptr<PendingLoad> load = pending;
+    getWorkerPool().submit([load, path, flipUVs] {
+      importModel(path, flipUVs, load->data);
+      load->imported = true;
+    });
+    modelLoader.add(this);
+  }
+  ~Model() {
+    modelLoader.remove(this);
+    for (auto &mesh : meshes)
+      mesh.release();
+    deleteTextureArrays(textureArrays);
+    for (unsigned int id : textures_loaded)
+      textureRegistry.release(id);
+  }
+  // meshes and texture references are owned, so models are not copied
+  Model(const Model &) = delete;
+  Model &operator=(const Model &) = delete;
+
+  // true once every mesh is on the GPU
+  bool ready() const { return !pending; }
+  // true once the worker has finished with the model
+  bool imported() const { return !pending || pending->imported; }
+
+  // creates the meshes of an imported model in order until budgetBytes of
+  // geometry were uploaded, at least one per call. Returns the bytes
+  // uploaded. GL thread only.
+  size_t createMeshes(size_t budgetBytes) {
+    size_t uploaded = 0;
+    ModelData &data = pending->data;
+    meshes.reserve(data.meshes.size());
+    while (pending->nextMesh < data.meshes.size() && uploaded < budgetBytes) {
+      MeshData &mesh = data.meshes[pending->nextMesh++];
+      uploaded += mesh.vertices.size() * sizeof(Vertex) +
+                  mesh.skin.size() * sizeof(SkinVertex) +
+                  mesh.indices.size() * sizeof(unsigned int);
+      for (auto &lod : mesh.lodIndices)
+        uploaded += lod.size() * sizeof(unsigned int);
+      // resolve every material's textures once, meshes share them
+      auto it = pending->textures.find(mesh.materialIndex);
+      if (it == pending->textures.end()) {
+        vector<Texture> textures;
+        for (auto &ref : data.materials[mesh.materialIndex])
+          textures.push_back(loadTexture(ref.path, ref.type,
+                                         data.textureHashes[ref.path]));
+        it = pending->textures.emplace(mesh.materialIndex, textures).first;
+      }
+      meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices),
+                          it->second, vertexFormat, std::move(mesh.lodIndices),
+                          std::move(mesh.meshlets), residency,
+                          std::move(mesh.skin));
+      meshes.back().sourceMeshes = mesh.sourceMeshes;
+      meshMaterials.push_back(mesh.materialIndex);
+    }
+    if (pending->nextMesh == data.meshes.size()) {
+      boundsCenter = data.boundsCenter;
+      boundsRadius = data.boundsRadius;
+      skeleton = std::move(data.skeleton);
+      cout << "Model ready: " << pending->path << " (" << meshes.size()
+           << " meshes, ";
+      if (!skeleton.empty())
+        cout << skeleton.joints.size() << " joints, " << skeleton.clips.size()
+             << " animations, ";
+      cout << elapsedMs(pending->start, chrono::steady_clock::now()) << " ms)"
+           << endl;
+      pending.reset();
+      if (TEXTURE_ARRAYS_ENABLED && !TEXTURE_STREAMING)
+        modelLoader.awaitTextures(this);
+    }
+    return uploaded;
+  }
+
+  // Copies the textures of every material that has at most one per slot
+  // into texture arrays, so those meshes bind arrays shared across the model
+  // instead of their own textures. The model then lets go of the separate
+  // textures nothing else of it uses. Call once all textures are uploaded.
+  void packTextures() {
+    vector<unsigned int> candidates;
+    for (auto &mesh : meshes)
+      if (mesh.material.canUseArrays())
+        for (auto &texture : mesh.textures)
+          if (find(candidates.begin(), candidates.end(), texture.id) ==
+              candidates.end())
+            candidates.push_back(texture.id);
+    auto layers = packTextureArrays(candidates, textureArrays);
+
+    vector<unsigned int> stillBound; // by meshes that keep separate textures
+    unsigned int packed = 0;
+    for (auto &mesh : meshes) {
+      if (mesh.material.useArrays(layers))
+        packed++;
+      else
+        for (auto &texture : mesh.textures)
+          stillBound.push_back(texture.id);
+    }
+    vector<unsigned int> kept;
+    for (unsigned int id : textures_loaded)
+      if (!layers.count(id) || find(stillBound.begin(), stillBound.end(),
+                                    id) != stillBound.end())
+        kept.push_back(id);
+      else
+        textureRegistry.release(id);
+    textures_loaded.swap(kept);
+    cout << "Texture arrays for " << directory << ": " << layers.size()
+         << " textures in " << textureArrays.size() << " arrays, " << packed
+         << "/" << meshes.size() << " meshes" << endl;
+  }
+
+  // draws the model, and thus all its meshes, at the given level of detail.
+  // A cull frame skips the meshlets it can't see. Skinned meshes are posed
+  // by the joint matrices from jointBase on (see Skinning), or drawn in
+  // their bind pose without them.
+  void Draw(Shader &shader, unsigned int lod = 0,
+            const CullFrame *cull = nullptr, int jointBase = -1) {
+    if (!ready())
+      return;
+    // textures may have been bound behind the materials' back since the
+    // last model
+    invalidateMaterialBindings();
+    // meshes share one VAO per vertex format, bind it only when it changes
+    GeometryArena *bound = nullptr;
+    // skinning stays off outside of skinned meshes, so only they and the
+    // mesh after them touch the uniforms
+    bool skinned = false;
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+      if (meshes[i].arena != bound) {
+        bound = meshes[i].arena;
+        bound->bind();
+      }
+      bool skin = meshes[i].skinned && jointBase >= 0;
+      if (skin)
+        setSkinUniforms(shader, true,
+                        bound->skinBase(meshes[i].geometry), jointBase);
+      else if (skinned)
+        setSkinUniforms(shader, false);
+      skinned = skin;
+      meshes[i].DrawBound(shader, lod, cull);
+    }
+    if (skinned)
+      setSkinUniforms(shader, false);
+    glBindVertexArray(0);
+  }
+
+  // system memory the meshes' geometry takes now
+  size_t cpuBytes() const {
+    size_t bytes = 0;
+    for (auto &mesh : meshes)
+      bytes += mesh.cpuBytes();
+    return bytes;
+  }
+  // system memory the meshes' geometry would take under a residency policy
+  size_t cpuBytes(GeometryResidency policy) const {
+    size_t bytes = 0;
+    for (auto &mesh : meshes)
+      bytes += mesh.cpuBytes(policy);
+    return bytes;
+  }
 
-  // constructor, expects a filepath to a 3D model.
-  Model(string const &path, bool flipUVs = true, bool gamma = true) : gammaCorrection(gamma) {
-    loadModel(path, flipUVs);
+  // tells the texture streamer how many screen pixels a UV unit of each
+  // visible mesh covers, from the mesh's nearest point to lodView. Called
+  // from the G-buffer pass.
+  void requestTextures(const glm::mat4 &modelMatrix) const {
+    float scale = max(max(glm::length(glm::vec3(modelMatrix[0])),
+                          glm::length(glm::vec3(modelMatrix[1]))),
+                      glm::length(glm::vec3(modelMatrix[2])));
+    for (auto &mesh : meshes) {
+      if (mesh.uvScale <= 0.f || mesh.textures.empty())
+        continue;
+      glm::vec3 center =
+          glm::vec3(modelMatrix * glm::vec4(mesh.boundsCenter, 1.f));
+      float radius = mesh.boundsRadius * scale;
+      if (!clusterCulling.sphereVisible(center, radius))
+        continue;
+      float distance =
+          max(glm::length(center - lodView.position) - radius, 0.01f);
+      float pixelsPerUV =
+          lodView.projectionScale * mesh.uvScale * scale / distance;
+      for (auto &texture : mesh.textures)
+        textureStreamer.demand(texture.id, pixelsPerUV);
+    }
   }
 
-  // draws the model, and thus all its meshes
-  void Draw(Shader &shader) {
-    for (unsigned int i = 0; i < meshes.size(); i++)
-      meshes[i].Draw(shader);
+  // number of LOD levels of the most detailed mesh, full detail included
+  unsigned int lodCount() const {
+    size_t count = 1;
+    for (auto &mesh : meshes)
+      count = max(count, mesh.lods.size());
+    return count;
   }
 
 private:
-  // loads a model with supported ASSIMP extensions from file and stores the
-  // resulting meshes in the meshes vector.
-  void loadModel(string const &path, bool flipUV) {
-    cout << "Start loading model from: " + path << endl;
+  // state of a load until all meshes are created. Shared with the import
+  // job, which only touches data and imported.
+  struct PendingLoad {
+    string path;
+    ModelData data;
+    atomic<bool> imported{false};
+    size_t nextMesh = 0;
+    map<unsigned int, vector<Texture>> textures; // resolved per material
+    chrono::steady_clock::time_point start;
+  };
+  shared_ptr<PendingLoad> pending; // null once ready
+
+  // everything of a load that needs no GL context: the processed mesh cache
+  // or Assimp, mesh conversion, writing the cache and batching. Runs on a
+  // worker for async loads. Leaves data empty if the model can't be read.
+  static void importModel(string const &path, bool flipUV, ModelData &data) {
+    readModel(path, flipUV, data);
+    // the cache holds the meshes as imported, so batching stays optional
+    if (MESH_BATCHING_ENABLED)
+      batchMeshes(data);
+    computeBounds(data);
+    hashTextures(path.substr(0, path.find_last_of('/')), data);
+  }
+
+  // reads the meshes of a model from its cache or, failing that, from the
+  // source file through the built-in OBJ reader or Assimp, writing the cache
+  // for the next start
+  static void readModel(string const &path, bool flipUV, ModelData &data) {
+    // joined vertices give indexed meshes, which the vertex cache, LOD and
+    // meshlet passes need; Assimp emits three vertices per triangle otherwise
+    unsigned int importFlags = aiProcess_Triangulate |
+                               aiProcess_JoinIdenticalVertices |
+                               aiProcess_CalcTangentSpace |
+                               (flipUV ? aiProcess_FlipUVs : 0);
+
+    // try the processed mesh cache first, it skips Assimp entirely
+    uint64_t cacheKey = 0;
+    if (MESH_CACHE_ENABLED) {
+      cacheKey = meshCacheKey(path, importFlags);
+      if (cacheKey && loadFromCache(meshCachePath(path), cacheKey, data))
+        return;
+    }
+
+    if (BUILTIN_OBJ_LOADER && isObjPath(path)) {
+      auto start = chrono::steady_clock::now();
+      if (readObj(path, flipUV, data.meshes, data.materials)) {
+        finishMeshes(data.meshes, vector<char>(data.meshes.size(), 1));
+        logProcessed(data.meshes,
+                     elapsedMs(start, chrono::steady_clock::now()));
+        unsigned int materialCount =
+            data.materials.empty() ? 0 : data.materials.rbegin()->first + 1;
+        if (MESH_CACHE_ENABLED && cacheKey)
+          saveToCache(meshCachePath(path), cacheKey, materialCount, data);
+        return;
+      }
+      cout << "::Warning:: Falling back to Assimp for " << path << endl;
+    }
+
     // read file via ASSIMP
+    auto importStart = chrono::steady_clock::now();
     Assimp::Importer importer;
-    const aiScene *scene = importer.ReadFile(
-        path, aiProcess_Triangulate | aiProcess_CalcTangentSpace |
-                  (flipUV ? aiProcess_FlipUVs : 0));
+    const aiScene *scene = importer.ReadFile(path, importFlags);
+    cout << "Assimp import: "
+         << elapsedMs(importStart, chrono::steady_clock::now()) << " ms"
+         << endl;
     // check for errors
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
         !scene->mRootNode) // if is Not Zero
@@ -64,95 +374,464 @@ private:
       cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
       return;
     }
-    // retrieve the directory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
 
-    // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
+    // process ASSIMP's nodes and meshes
+    processScene(scene, data);
+
+    // the cache holds static geometry only, skinned models (and their
+    // animations) always come from Assimp
+    if (MESH_CACHE_ENABLED && cacheKey && data.skeleton.empty())
+      saveToCache(meshCachePath(path), cacheKey, scene->mNumMaterials, data);
   }
 
-  // processes a node in a recursive fashion. Processes each individual mesh
-  // located at the node and repeats this process on its children nodes (if
-  // any).
-  void processNode(aiNode *node, const aiScene *scene) {
-    // process each mesh located at the current node
-    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-      // the node object only contains indices to index the actual objects in
-      // the scene. the scene contains all the data, node is just to keep stuff
-      // organized (like relations between nodes).
-      aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-      meshes.push_back(processMesh(mesh, scene));
+  // merges the meshes that bind the same textures, so each texture set costs
+  // one draw instead of one per imported mesh
+  static void batchMeshes(ModelData &data) {
+    map<string, unsigned int> textureSets;
+    vector<unsigned int> groups;
+    for (auto &mesh : data.meshes) {
+      string key = mesh.skin.empty() ? "" : "skinned\n";
+      for (auto &texture : data.materials[mesh.materialIndex])
+        key += texture.type + '\n' + texture.path + '\n';
+      groups.push_back(
+          textureSets.emplace(key, textureSets.size()).first->second);
     }
-    // after we've processed all of the meshes (if any) we then recursively
-    // process each of the children nodes
-    for (unsigned int i = 0; i < node->mNumChildren; i++) {
-      processNode(node->mChildren[i], scene);
+    size_t before = data.meshes.size();
+    mergeMeshes(data.meshes, groups);
+    cout << "Meshes batched by texture set: " << before << " -> "
+         << data.meshes.size() << endl;
+  }
+
+  static void hashTextures(const string &directory, ModelData &data) {
+    vector<string> paths;
+    for (auto &material : data.materials)
+      for (auto &texture : material.second)
+        if (data.textureHashes.emplace(texture.path, 0).second)
+          paths.push_back(texture.path);
+    vector<uint64_t> hashes(paths.size());
+    getWorkerPool().parallelFor(paths.size(), [&](size_t i) {
+      hashes[i] = textureSourceHash(directory + '/' + paths[i]);
+    });
+    for (size_t i = 0; i < paths.size(); i++)
+      data.textureHashes[paths[i]] = hashes[i];
+  }
+
+  static void computeBounds(ModelData &data) {
+    bool first = true;
+    glm::vec3 lo(0.f), hi(0.f);
+    for (auto &mesh : data.meshes)
+      for (auto &vertex : mesh.vertices) {
+        lo = first ? vertex.Position : glm::min(lo, vertex.Position);
+        hi = first ? vertex.Position : glm::max(hi, vertex.Position);
+        first = false;
+      }
+    data.boundsCenter = (lo + hi) * 0.5f;
+    data.boundsRadius = 0.f;
+    for (auto &mesh : data.meshes)
+      for (auto &vertex : mesh.vertices)
+        data.boundsRadius =
+            max(data.boundsRadius,
+                glm::length(vertex.Position - data.boundsCenter));
+  }
+
+  // reads the meshes from a processed mesh cache file, decoding them in
+  // parallel. returns false if there is no valid cache for this key.
+  static bool loadFromCache(const string &cachePath, uint64_t key,
+                            ModelData &data) {
+    MeshCache cache;
+    if (!cache.open(cachePath, key))
+      return false;
+    auto start = chrono::steady_clock::now();
+    data.meshes.resize(cache.meshCount());
+    atomic<bool> corrupt{false};
+    getWorkerPool().parallelFor(cache.meshCount(), [&](size_t i) {
+      const MeshCacheMesh &entry = cache.mesh(i);
+      MeshData &mesh = data.meshes[i];
+      mesh.materialIndex = entry.materialIndex;
+      vector<unsigned int> indices(entry.indexCount);
+      mesh.vertices.resize(entry.vertexCount);
+      if (!cache.readVertices(entry, mesh.vertices.data()) ||
+          !cache.readIndices(entry, indices.data())) {
+        corrupt = true;
+        return;
+      }
+      const unsigned int *level = indices.data();
+      mesh.indices.assign(level, level + entry.lodIndexCount[0]);
+      for (unsigned int lod = 1; lod < entry.lodCount; lod++) {
+        level += entry.lodIndexCount[lod - 1];
+        mesh.lodIndices.emplace_back(level, level + entry.lodIndexCount[lod]);
+      }
+      const Meshlet *meshlets = cache.meshlets(entry);
+      mesh.meshlets.assign(meshlets, meshlets + entry.meshletCount);
+    });
+    if (corrupt) {
+      cout << "::Warning:: Corrupt mesh cache: " << cachePath << endl;
+      data.meshes.clear();
+      return false;
+    }
+    double decodeMs = elapsedMs(start, chrono::steady_clock::now());
+
+    uint64_t stored = 0, raw = 0;
+    for (unsigned int i = 0; i < cache.meshCount(); i++) {
+      const MeshCacheMesh &entry = cache.mesh(i);
+      if (!data.materials.count(entry.materialIndex))
+        data.materials[entry.materialIndex] =
+            cache.materialTextures(entry.materialIndex);
+      stored += cache.storedBytes(entry);
+      raw += uint64_t(entry.vertexCount) * sizeof(Vertex) +
+             uint64_t(entry.indexCount) * sizeof(unsigned int);
     }
+    cout << "Model loaded from mesh cache: " << cachePath << " ("
+         << data.meshes.size() << " meshes, " << stored / 1048576.0
+         << " MB stored, " << raw / 1048576.0 << " MB decoded, ratio "
+         << double(raw) / max<uint64_t>(stored, 1) << ", " << decodeMs
+         << " ms, " << raw / 1e6 / max(decodeMs, 1e-3) << " GB/s)" << endl;
+    return true;
   }
 
-  Mesh processMesh(aiMesh *mesh, const aiScene *scene) {
-    // data to fill
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
+  static void saveToCache(const string &cachePath, uint64_t key,
+                          unsigned int materialCount, const ModelData &data) {
+    vector<MeshCacheInput> inputs;
+    vector<vector<Texture>> materials(materialCount);
+    for (auto &mesh : data.meshes) {
+      MeshCacheInput input;
+      input.vertices = mesh.vertices.data();
+      input.vertexCount = mesh.vertices.size();
+      input.indices = mesh.indices.data();
+      input.indexCount = mesh.indices.size();
+      input.materialIndex = mesh.materialIndex;
+      input.lodIndices = &mesh.lodIndices;
+      input.meshlets = &mesh.meshlets;
+      inputs.push_back(input);
+    }
+    for (auto &material : data.materials)
+      materials[material.first] = material.second;
+    if (writeMeshCache(cachePath, key, inputs, materials))
+      cout << "Mesh cache written: " << cachePath << endl;
+  }
+
+  // converts the whole scene into data. The meshes are turned into
+  // vertex/index arrays on the worker pool, in node order; GL resources are
+  // created later by createMeshes.
+  static void processScene(const aiScene *scene, ModelData &data) {
+    auto start = chrono::steady_clock::now();
+    vector<aiMesh *> sceneMeshes;
+    processNode(scene->mRootNode, scene, sceneMeshes);
+    vector<vector<uint8_t>> boneJoints;
+    importSkeleton(scene, sceneMeshes, data.skeleton, boneJoints);
 
+    vector<MeshData> &meshData = data.meshes;
+    meshData.resize(sceneMeshes.size());
+    atomic<unsigned int> extraTexCoords{0};
+    vector<char> triangles(sceneMeshes.size());
+    getWorkerPool().parallelFor(sceneMeshes.size(), [&](size_t i) {
+      processMesh(sceneMeshes[i], boneJoints[i], meshData[i]);
+      if (sceneMeshes[i]->mTextureCoords[1])
+        extraTexCoords++;
+      // points and lines survive aiProcess_Triangulate, leave those alone
+      triangles[i] =
+          sceneMeshes[i]->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+    });
+    if (extraTexCoords)
+      cout << "::Warning:: Extra mesh texcoords found in " << extraTexCoords
+           << " meshes." << endl;
+    finishMeshes(meshData, triangles);
+    auto converted = chrono::steady_clock::now();
+
+    for (auto &mesh : meshData)
+      if (!data.materials.count(mesh.materialIndex))
+        data.materials[mesh.materialIndex] =
+            loadMaterial(scene->mMaterials[mesh.materialIndex]);
+    logProcessed(meshData, elapsedMs(start, converted));
+  }
+
+  // optimizes the meshes flagged in triangles for the vertex cache and
+  // builds their meshlets and LODs on the worker pool
+  static void finishMeshes(vector<MeshData> &meshData,
+                           const vector<char> &triangles) {
+    vector<VertexCacheStats> before(meshData.size()), after(meshData.size());
+    getWorkerPool().parallelFor(meshData.size(), [&](size_t i) {
+      if (!triangles[i])
+        return;
+      if (MESH_OPTIMIZE_ENABLED)
+        optimizeMesh(meshData[i], before[i], after[i]);
+      // meshlet bounds only hold in the bind pose
+      if (meshData[i].skin.empty())
+        buildMeshlets(meshData[i], MESHLET_MAX_TRIANGLES,
+                      MESHLET_MAX_VERTICES);
+      if (MESH_LOD_LEVELS > 0)
+        generateMeshLods(meshData[i], MESH_LOD_LEVELS, MESH_LOD_MAX_ERROR,
+                         MESH_LOD_MIN_TRIANGLES);
+    });
+    if (MESH_OPTIMIZE_ENABLED) {
+      VertexCacheStats totalBefore, totalAfter;
+      for (size_t i = 0; i < meshData.size(); i++) {
+        totalBefore.add(before[i]);
+        totalAfter.add(after[i]);
+      }
+      cout << "Vertex cache optimized: ACMR " << totalBefore.acmr() << " -> "
+           << totalAfter.acmr() << ", ATVR " << totalBefore.atvr() << " -> "
+           << totalAfter.atvr() << endl;
+    }
+  }
+
+  // prints the triangles per LOD level and the mesh and meshlet counts
+  static void logProcessed(const vector<MeshData> &meshData,
+                           double convertMs) {
+    if (MESH_LOD_LEVELS > 0) {
+      vector<size_t> lodTriangles;
+      for (auto &mesh : meshData)
+        for (size_t lod = 0; lod <= MESH_LOD_LEVELS; lod++) {
+          if (lodTriangles.size() <= lod)
+            lodTriangles.push_back(0);
+          // meshes without a level draw their coarsest one instead
+          const vector<unsigned int> &indices =
+              lod == 0 || mesh.lodIndices.empty()
+                  ? mesh.indices
+                  : mesh.lodIndices[min(lod, mesh.lodIndices.size()) - 1];
+          lodTriangles[lod] += indices.size() / 3;
+        }
+      cout << "LOD triangles:";
+      for (size_t count : lodTriangles)
+        cout << " " << count;
+      cout << endl;
+    }
+
+    size_t meshletCount = 0;
+    for (auto &mesh : meshData)
+      meshletCount += mesh.meshlets.size();
+    cout << "Model processed: " << meshData.size() << " meshes, "
+         << meshletCount << " meshlets, convert " << convertMs << " ms ("
+         << getWorkerPool().size() + 1 << " threads)" << endl;
+  }
+
+  // collects the meshes of a node and, recursively, of its children in a
+  // fixed depth-first order.
+  static void processNode(aiNode *node, const aiScene *scene,
+                          vector<aiMesh *> &sceneMeshes) {
+    // the node object only contains indices to index the actual objects in
+    // the scene. the scene contains all the data, node is just to keep stuff
+    // organized (like relations between nodes).
+    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+      sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+      processNode(node->mChildren[i], scene, sceneMeshes);
+  }
+
+  static glm::mat4 toGlm(const aiMatrix4x4 &m) {
+    // assimp matrices are row major
+    return glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3,
+                     m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+  }
+
+  // Flattens the node hierarchy, maps the bones of every mesh onto joints
+  // shared by the whole model and converts the animations. boneJoints[i][b]
+  // becomes the joint of bone b of sceneMeshes[i]; it stays empty for static
+  // meshes and for meshes whose bones don't fit, which are drawn unskinned.
+  static void importSkeleton(const aiScene *scene,
+                             const vector<aiMesh *> &sceneMeshes,
+                             Skeleton &skeleton,
+                             vector<vector<uint8_t>> &boneJoints) {
+    boneJoints.assign(sceneMeshes.size(), {});
+    bool bones = false;
+    for (auto *mesh : sceneMeshes)
+      bones = bones || mesh->HasBones();
+    if (!bones)
+      return;
+
+    map<string, unsigned int> nodeIndex;
+    vector<pair<const aiNode *, int>> toVisit{{scene->mRootNode, -1}};
+    while (!toVisit.empty()) {
+      const aiNode *node = toVisit.back().first;
+      int parent = toVisit.back().second;
+      toVisit.pop_back();
+      nodeIndex[node->mName.C_Str()] = skeleton.nodes.size();
+      skeleton.nodes.push_back(
+          {node->mName.C_Str(), parent, toGlm(node->mTransformation)});
+      for (unsigned int i = 0; i < node->mNumChildren; i++)
+        toVisit.push_back(
+            {node->mChildren[i], int(skeleton.nodes.size()) - 1});
+    }
+    skeleton.globalInverse =
+        glm::inverse(toGlm(scene->mRootNode->mTransformation));
+
+    for (size_t i = 0; i < sceneMeshes.size(); i++) {
+      const aiMesh *mesh = sceneMeshes[i];
+      vector<uint8_t> joints;
+      for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+        const aiBone *bone = mesh->mBones[b];
+        auto node = nodeIndex.find(bone->mName.C_Str());
+        if (node == nodeIndex.end())
+          break;
+        // meshes bound to the same node with the same bind pose share a joint
+        glm::mat4 offset = toGlm(bone->mOffsetMatrix);
+        size_t joint = 0;
+        while (joint < skeleton.joints.size() &&
+               (skeleton.joints[joint].node != node->second ||
+                skeleton.joints[joint].offset != offset))
+          joint++;
+        if (joint == MAX_SKIN_JOINTS)
+          break;
+        if (joint == skeleton.joints.size())
+          skeleton.joints.push_back({node->second, offset});
+        joints.push_back(joint);
+      }
+      if (joints.size() == mesh->mNumBones)
+        boneJoints[i].swap(joints);
+      else
+        cout << "::Warning:: Mesh " << mesh->mName.C_Str()
+             << " has bones without a node or past " << MAX_SKIN_JOINTS
+             << " joints, drawn unskinned." << endl;
+    }
+
+    for (unsigned int a = 0; a < scene->mNumAnimations; a++)
+      skeleton.clips.push_back(
+          importAnimation(scene->mAnimations[a], nodeIndex));
+  }
+
+  static AnimationClip importAnimation(const aiAnimation *animation,
+                                       const map<string, unsigned int> &nodes) {
+    AnimationClip clip;
+    clip.name = animation->mName.C_Str();
+    double ticks =
+        animation->mTicksPerSecond > 0 ? animation->mTicksPerSecond : 25.0;
+    clip.duration = float(animation->mDuration / ticks);
+    for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+      const aiNodeAnim *channel = animation->mChannels[c];
+      auto node = nodes.find(channel->mNodeName.C_Str());
+      if (node == nodes.end())
+        continue;
+      AnimationTrack track;
+      track.node = node->second;
+      for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+        const aiVectorKey &key = channel->mPositionKeys[k];
+        track.positionTimes.push_back(float(key.mTime / ticks));
+        track.positions.push_back(
+            glm::vec4(key.mValue.x, key.mValue.y, key.mValue.z, 0.f));
+      }
+      for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+        const aiQuatKey &key = channel->mRotationKeys[k];
+        track.rotationTimes.push_back(float(key.mTime / ticks));
+        track.rotations.push_back(
+            glm::vec4(key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w));
+      }
+      for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+        const aiVectorKey &key = channel->mScalingKeys[k];
+        track.scaleTimes.push_back(float(key.mTime / ticks));
+        track.scales.push_back(
+            glm::vec4(key.mValue.x, key.mValue.y, key.mValue.z, 0.f));
+      }
+      clip.tracks.push_back(std::move(track));
+    }
+    return clip;
+  }
+
+  // keeps the MAX_BONE_INFLUENCE heaviest bone weights of every vertex,
+  // renormalized and quantized to unorm16
+  static void processSkin(const aiMesh *mesh, const vector<uint8_t> &joints,
+                          vector<SkinVertex> &skin) {
+    const int n = MAX_BONE_INFLUENCE;
+    vector<float> weights(size_t(mesh->mNumVertices) * n, 0.f);
+    skin.assign(mesh->mNumVertices, SkinVertex{});
+    for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+      const aiBone *bone = mesh->mBones[b];
+      for (unsigned int k = 0; k < bone->mNumWeights; k++) {
+        unsigned int vertex = bone->mWeights[k].mVertexId;
+        float weight = bone->mWeights[k].mWeight;
+        float *slots = &weights[size_t(vertex) * n];
+        int lightest = 0;
+        for (int slot = 1; slot < n; slot++)
+          if (slots[slot] < slots[lightest])
+            lightest = slot;
+        if (weight > slots[lightest]) {
+          slots[lightest] = weight;
+          skin[vertex].joints[lightest] = joints[b];
+        }
+      }
+    }
+    for (unsigned int v = 0; v < mesh->mNumVertices; v++) {
+      const float *slots = &weights[size_t(v) * n];
+      float sum = 0.f;
+      int heaviest = 0;
+      for (int slot = 0; slot < n; slot++) {
+        sum += slots[slot];
+        if (slots[slot] > slots[heaviest])
+          heaviest = slot;
+      }
+      // unweighted vertices follow the mesh's first bone rather than collapse
+      if (sum <= 0.f) {
+        skin[v].joints[0] = joints[0];
+        skin[v].weights[0] = 65535;
+        continue;
+      }
+      int total = 0;
+      for (int slot = 0; slot < n; slot++) {
+        skin[v].weights[slot] =
+            uint16_t(std::round(slots[slot] / sum * 65535.f));
+        total += skin[v].weights[slot];
+      }
+      // rounding error goes to the heaviest weight so they sum up exactly
+      skin[v].weights[heaviest] =
+          uint16_t(skin[v].weights[heaviest] + 65535 - total);
+    }
+  }
+
+  // converts one assimp mesh into pre-sized vertex and index arrays, and its
+  // bones into a skin if boneJoints maps them. runs on worker threads, so it
+  // must not touch GL or any shared model state.
+  static void processMesh(const aiMesh *mesh, const vector<uint8_t> &boneJoints,
+                          MeshData &data) {
+    data.materialIndex = mesh->mMaterialIndex;
+    data.vertices.resize(mesh->mNumVertices);
     // walk through each of the mesh's vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-      Vertex vertex;
-      glm::vec3 vector; // we declare a placeholder vector since assimp uses its
-                        // own vector class that doesn't directly convert to
-                        // glm's vec3 class so we transfer the data to this
-                        // placeholder glm::vec3 first.
+      Vertex &vertex = data.vertices[i];
+      // assimp uses its own vector class that doesn't directly convert to
+      // glm's, so the components are copied over one by one.
       // positions
-      vector.x = mesh->mVertices[i].x;
-      vector.y = mesh->mVertices[i].y;
-      vector.z = mesh->mVertices[i].z;
-      vertex.Position = vector;
+      vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y,
+                                  mesh->mVertices[i].z);
       // normals
-      if (mesh->HasNormals()) {
-        vector.x = mesh->mNormals[i].x;
-        vector.y = mesh->mNormals[i].y;
-        vector.z = mesh->mNormals[i].z;
-        vertex.Normal = vector;
-      }
+      if (mesh->HasNormals())
+        vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y,
+                                  mesh->mNormals[i].z);
       // texture coordinates
       if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
       {
-        glm::vec2 vec;
         // a vertex can contain up to 8 different texture coordinates. We thus
         // make the assumption that we won't use models where a vertex can have
         // multiple texture coordinates so we always take the first set (0).
-        vec.x = mesh->mTextureCoords[0][i].x;
-        vec.y = mesh->mTextureCoords[0][i].y;
-        vertex.TexCoords = vec;
+        vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x,
+                                     mesh->mTextureCoords[0][i].y);
         // tangent
-        vector.x = mesh->mTangents[i].x;
-        vector.y = mesh->mTangents[i].y;
-        vector.z = mesh->mTangents[i].z;
-        vertex.Tangent = vector;
+        vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y,
+                                   mesh->mTangents[i].z);
         // bitangent
-        vector.x = mesh->mBitangents[i].x;
-        vector.y = mesh->mBitangents[i].y;
-        vector.z = mesh->mBitangents[i].z;
-        vertex.Bitangent = vector;
+        vertex.Bitangent =
+            glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y,
+                      mesh->mBitangents[i].z);
       } else
         vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-      if (mesh->mTextureCoords[1]) {
-        cout << "::Warning:: Extra mesh texcoords found." << endl;
-      }
-      vertices.push_back(vertex);
     }
-    // now wak through each of the mesh's faces (a face is a mesh its triangle)
-    // and retrieve the corresponding vertex indices.
+    // now walk through each of the mesh's faces (a face is a mesh its
+    // triangle) and retrieve the corresponding vertex indices.
+    size_t indexCount = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+      indexCount += mesh->mFaces[i].mNumIndices;
+    data.indices.resize(indexCount);
+    unsigned int *out = data.indices.data();
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-      aiFace face = mesh->mFaces[i];
-      // retrieve all indices of the face and store them in the indices vector
+      const aiFace &face = mesh->mFaces[i];
       for (unsigned int j = 0; j < face.mNumIndices; j++)
-        indices.push_back(face.mIndices[j]);
+        *out++ = face.mIndices[j];
     }
-    // process materials
-    aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+    if (!boneJoints.empty())
+      processSkin(mesh, boneJoints, data.skin);
+  }
+
+  // collects the texture references (id left at 0) of a material.
+  static vector<Texture> loadMaterial(aiMaterial *material) {
+    vector<Texture> textures;
     // we assume a convention for sampler names in the shaders. Each diffuse
     // texture should be named as 'texture_diffuseN' where N is a sequential
     // number ranging from 1 to MAX_SAMPLER_NUMBER. Same applies to other
@@ -176,94 +855,46 @@ private:
     std::vector<Texture> heightMaps =
         loadMaterialTextures(material, aiTextureType_DISPLACEMENT, "texture_height");
     textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-    // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+    return textures;
   }
 
-  // checks all material textures of a given type and loads the textures if
-  // they're not loaded yet. the required info is returned as a Texture struct.
-  vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type,
-                                       string typeName) {
+  // checks all material textures of a given type. the required info is
+  // returned as a Texture struct, the texture itself is loaded by
+  // loadTexture once the mesh is created.
+  static vector<Texture> loadMaterialTextures(aiMaterial *mat,
+                                              aiTextureType type,
+                                              string typeName) {
     vector<Texture> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
       aiString str;
       mat->GetTexture(type, i, &str);
-      // check if texture was loaded before and if so, continue to next
-      // iteration: skip loading a new texture
-      bool skip = false;
-      for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-        if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-          // cout << "Texture in cache has been loaded: \n";
-          // cout << "  Type: " + textures_loaded[j].type << endl;
-          // cout << "  Path: " + textures_loaded[j].path << endl;
-          textures.push_back(textures_loaded[j]);
-          skip = true; // a texture with the same filepath has already been
-                       // loaded, continue to next one. (optimization)
-          break;
-        }
-      }
-      if (!skip) { // if texture hasn't been loaded already, load it
-        Texture texture;
-        texture.id = TextureFromFile(str.C_Str(), this->directory,
-                                     typeName == "texture_diffuse");
-        texture.type = typeName;
-        texture.path = str.C_Str();
-        textures.push_back(texture);
-        textures_loaded.push_back(
-            texture); // store it as texture loaded for entire model, to ensure
-                      // we won't unnecessary load duplicate textures.
-        cout << "Texture has been loaded: \n";
-        cout << "  Type: " + texture.type << endl;
-        cout << "  Path: " + texture.path << endl;
-      }
+      Texture texture;
+      texture.id = 0;
+      texture.type = typeName;
+      texture.path = str.C_Str();
+      textures.push_back(texture);
     }
     return textures;
   }
-};
 
-inline unsigned int TextureFromFile(const char *path, const string &directory,
-                             bool gamma) {
-  string filename = string(path);
-  if(directory != "")
-    filename = directory + '/' + filename;
-
-  unsigned int textureID;
-  glGenTextures(1, &textureID);
-
-  int width, height, nrComponents;
-  unsigned char *data =
-      stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-  if (data) {
-    GLenum format_from, format_to;
-    if (nrComponents == 1)
-      format_from = format_to = GL_RED;
-    else if (nrComponents == 3)
-      format_from = GL_RGB, format_to = GL_SRGB;
-    else if (nrComponents == 4)
-      format_from = GL_RGBA, format_to = GL_SRGB_ALPHA;
-
-    if (!gamma) {
-      format_to = format_from;
-    }
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, format_to, width, height, 0, format_from,
-                 GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                    GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
-  } else {
-    std::cout << "Texture failed to load at path: " << path << std::endl;
-    stbi_image_free(data);
+  // returns the texture at path relative to the model directory. Textures
+  // are shared process-wide through the texture registry, which only loads
+  // each file (per colour space) once, and identical files (same sourceHash)
+  // once between them.
+  Texture loadTexture(const string &path, const string &typeName,
+                      uint64_t sourceHash = 0) {
+    Texture texture;
+    texture.id = textureRegistry.acquire(
+        path, this->directory, typeName == "texture_diffuse",
+        typeName == "texture_diffuse"  ? TEXTURE_COLOR
+        : typeName == "texture_normal" ? TEXTURE_NORMAL
+                                       : TEXTURE_DATA,
+        TEXTURE_STREAMING, sourceHash);
+    texture.type = typeName;
+    texture.path = path;
+    textures_loaded.push_back(texture.id);
+    return texture;
   }
+};
 
-  return textureID;
-}
 #endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "model_loader.h"
+#include "model.h"
+#include "texture_loader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+using namespace std;
+
+ModelLoader modelLoader;
+
+void ModelLoader::add(Model *model) { models.push_back(model); }
+
+void ModelLoader::remove(Model *model) {
+  models.erase(std::remove(models.begin(), models.end(), model), models.end());
+  packing.erase(std::remove(packing.begin(), packing.end(), model),
+                packing.end());
+}
+
+void ModelLoader::awaitTextures(Model *model) { packing.push_back(model); }
+
+void ModelLoader::update(size_t budgetBytes) {
+  size_t uploaded = 0;
+  // earlier requests go first, so models appear in the order they were asked
+  // for whenever their imports finish in time
+  for (size_t i = 0; i < models.size() && uploaded < budgetBytes;) {
+    Model *model = models[i];
+    if (!model->imported()) {
+      i++;
+      continue;
+    }
+    uploaded += model->createMeshes(budgetBytes - uploaded);
+    if (model->ready())
+      models.erase(models.begin() + i);
+    else
+      i++;
+  }
+
+  // texture sizes and formats are only known once they are uploaded
+  if (!packing.empty() && textureLoader.pending() == 0) {
+    for (Model *model : packing)
+      model->packTextures();
+    packing.clear();
+  }
+}
+
+void ModelLoader::finish() {
+  while (pending()) {
+    update(SIZE_MAX);
+    this_thread::yield();
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include "config.h"
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+class Model;
+
+// Finishes async model loads on the GL thread. Models import on the worker
+// pool by themselves; once that is done, update() creates their meshes,
+// limited to a byte budget of geometry per frame.
+class ModelLoader {
+public:
+  // async models register while they load and leave once ready or destroyed
+  void add(Model *model);
+  void remove(Model *model);
+  // packs the model's textures into arrays once no texture is streaming
+  void awaitTextures(Model *model);
+
+  // creates meshes of imported models until budgetBytes of geometry have
+  // been uploaded (at least one mesh per call). GL thread only, once per
+  // frame.
+  void update(size_t budgetBytes = size_t(MODEL_UPLOAD_BUDGET_MB) << 20);
+  // creates everything, waiting for outstanding imports
+  void finish();
+
+  // models still loading
+  unsigned int pending() const { return models.size(); }
+
+private:
+  vector<Model *> models; // in request order
+  vector<Model *> packing; // ready, waiting for their textures
+};
+
+extern ModelLoader modelLoader;
+
+#endif
@@ -3,6 +3,12 @@
 
 #include "utils.h"
 #include "model.h"
+#include "lod.h"
+#include "meshlet.h"
+#include "skinning.h"
+
+#include <memory>
+#include <vector>
 
 class Object {
 public:
@@ -11,6 +17,9 @@ public:
   float angle;
   glm::vec3 axis;
   Model model;
+  // clip the object plays once its model is ready, if it has a skeleton.
+  // Shared by every place the object is drawn at in a frame.
+  SkinnedInstance animation;
 
   glm::mat4 getModelMatrix() {
     glm::mat4 mat(1.f);
@@ -21,17 +30,51 @@ public:
     return mat;
   }
 
-  Object(string const &path, bool flipUVs = true, bool gamma = true)
-      : model(path, flipUVs, gamma) {
+  Object(string const &path, bool flipUVs = true, bool gamma = true,
+         VertexFormat format = DEFAULT_VERTEX_FORMAT,
+         GeometryResidency residency = DEFAULT_GEOMETRY_RESIDENCY,
+         bool async = false)
+      : model(path, flipUVs, gamma, format, residency, async) {
     position = {0.f, 0.f, 0.f};
     scale = {1.f, 1.f, 1.f};
     angle = 0;
     axis = {0.f, 0.f, 0.f};
+    animation.skeleton = &model.skeleton;
+    skinning.add(&animation);
+  }
+  ~Object() { skinning.remove(&animation); }
+
+  // starts loading an object and returns right away. The object can be
+  // placed at once but draws nothing until ready(); ModelLoader::update()
+  // finishes it over the following frames.
+  static unique_ptr<Object>
+  loadAsync(string const &path, bool flipUVs = true, bool gamma = true,
+            VertexFormat format = DEFAULT_VERTEX_FORMAT,
+            GeometryResidency residency = DEFAULT_GEOMETRY_RESIDENCY) {
+    return make_unique<Object>(path, flipUVs, gamma, format, residency,
+                               ASYNC_MODEL_LOADING);
   }
 
-  void Draw(Shader &shader) {
-    shader.setMat4("model", getModelMatrix());
-    model.Draw(shader);
+  bool ready() const { return model.ready(); }
+
+  // draws the object at the LOD its screen size calls for. Objects drawn
+  // several times per frame at different places pass a distinct instance
+  // for each, so each copy keeps its own LOD hysteresis.
+  void Draw(Shader &shader, unsigned int instance = 0) {
+    if (!ready())
+      return;
+    glm::mat4 modelMatrix = getModelMatrix();
+    shader.setMat4("model", modelMatrix);
+    if (model.gltf) {
+      model.gltf->Draw(shader, modelMatrix);
+      return;
+    }
+    if (textureStreamer.active)
+      model.requestTextures(modelMatrix);
+    CullFrame cull;
+    bool culling = clusterCulling.modelFrame(modelMatrix, cull);
+    model.Draw(shader, selectInstanceLod(modelMatrix, instance),
+               culling ? &cull : nullptr, animation.jointBase);
   }
 
   void setPosition(float x, float y, float z) { position = glm::vec3(x, y, z); }
@@ -39,6 +82,29 @@ public:
   void setScale(float scale) { this->scale = glm::vec3(scale, scale, scale); }
   void setAngle(float angle) { this->angle = angle; }
   void setAxis(float x, float y, float z) { axis = glm::vec3(x, y, z); }
+  // plays an animation clip of the model from the start, -1 for the bind
+  // pose
+  void playAnimation(int clip, float speed = 1.f) {
+    animation.clip = clip;
+    animation.time = 0.f;
+    animation.speed = speed;
+  }
+
+private:
+  vector<unsigned int> instanceLods;
+
+  unsigned int selectInstanceLod(const glm::mat4 &modelMatrix,
+                                 unsigned int instance) {
+    if (instanceLods.size() <= instance)
+      instanceLods.resize(instance + 1, 0);
+    glm::vec3 center =
+        glm::vec3(modelMatrix * glm::vec4(model.boundsCenter, 1.f));
+    float radius = model.boundsRadius *
+                   max(max(fabs(scale.x), fabs(scale.y)), fabs(scale.z));
+    unsigned int &lod = instanceLods[instance];
+    lod = selectLod(projectedSize(center, radius), lod, model.lodCount());
+    return lod;
+  }
 };
 
 #endif
\ No newline at end of file
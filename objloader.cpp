@@ -0,0 +1,661 @@
+#include "objloader.h"
+#include "mapped_file.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+using namespace std;
+
+namespace {
+// files are cut into chunks of at least this size, smaller ones are parsed
+// by one thread
+const size_t OBJ_MIN_CHUNK_BYTES = 1 << 20;
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+inline bool isDigit(char c) { return unsigned(c - '0') < 10; }
+
+inline const char *skipSpace(const char *p, const char *end) {
+  while (p < end && isSpace(*p))
+    p++;
+  return p;
+}
+
+// calls f(begin, end) for every line, without the newline
+template <typename F> void forEachLine(const char *p, const char *end, F f) {
+  while (p < end) {
+    const char *next = (const char *)memchr(p, '\n', end - p);
+    const char *lineEnd = next ? next : end;
+    f(p, lineEnd);
+    p = next ? next + 1 : end;
+  }
+}
+
+// the rest of a line without surrounding blanks
+string restOfLine(const char *p, const char *end) {
+  p = skipSpace(p, end);
+  while (end > p && isSpace(end[-1]))
+    end--;
+  return string(p, end);
+}
+
+const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Decimal float without strtod's locale handling, and bounded by end since
+// the mapped file isn't null terminated. Digits past the 19th only move the
+// exponent, which is plenty for a float.
+const char *parseFloat(const char *p, const char *end, float &out) {
+  p = skipSpace(p, end);
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+  uint64_t mantissa = 0;
+  int exponent = 0, digits = 0;
+  for (; p < end && isDigit(*p); p++) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    } else
+      exponent++;
+  }
+  if (p < end && *p == '.')
+    for (p++; p < end && isDigit(*p); p++)
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+        exponent--;
+      }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    bool negativeExponent = false;
+    if (q < end && (*q == '-' || *q == '+'))
+      negativeExponent = *q++ == '-';
+    if (q < end && isDigit(*q)) {
+      int value = 0;
+      for (; q < end && isDigit(*q); q++)
+        value = min(value * 10 + (*q - '0'), 10000);
+      exponent += negativeExponent ? -value : value;
+      p = q;
+    }
+  }
+  double value = double(mantissa);
+  if (exponent < 0)
+    value = exponent >= -22 ? value / POW10[-exponent]
+                            : value * pow(10.0, exponent);
+  else if (exponent > 0)
+    value = exponent <= 22 ? value * POW10[exponent]
+                           : value * pow(10.0, exponent);
+  out = float(negative ? -value : value);
+  return p;
+}
+
+// a face index as written: 1-based, negative counts back from the last
+// vertex, 0 if missing
+const char *parseIndex(const char *p, const char *end, long long &out) {
+  bool negative = p < end && *p == '-';
+  if (negative)
+    p++;
+  out = 0;
+  for (; p < end && isDigit(*p); p++)
+    out = out * 10 + (*p - '0');
+  if (negative)
+    out = -out;
+  return p;
+}
+
+// 0-based index of a face index, with count elements read so far
+inline int resolveIndex(long long index, size_t count) {
+  if (index > 0)
+    return index <= INT32_MAX ? int(index - 1) : -1;
+  if (index < 0 && -index <= (long long)count)
+    return int((long long)count + index);
+  return -1;
+}
+
+enum LineKind {
+  LINE_OTHER,
+  LINE_POSITION,
+  LINE_TEXCOORD,
+  LINE_NORMAL,
+  LINE_FACE,
+  LINE_SKIPPED, // lines and points, meshes only hold triangles
+  LINE_MATERIAL,
+  LINE_LIBRARY,
+  LINE_GROUP
+};
+
+// reads the keyword of a line and moves p past it
+LineKind classify(const char *&p, const char *end) {
+  p = skipSpace(p, end);
+  const char *word = p;
+  while (p < end && !isSpace(*p))
+    p++;
+  size_t length = p - word;
+  auto is = [&](const char *keyword) {
+    return length == strlen(keyword) && memcmp(word, keyword, length) == 0;
+  };
+  if (length == 0 || word[0] == '#')
+    return LINE_OTHER;
+  if (is("v"))
+    return LINE_POSITION;
+  if (is("vt"))
+    return LINE_TEXCOORD;
+  if (is("vn"))
+    return LINE_NORMAL;
+  if (is("f"))
+    return LINE_FACE;
+  if (is("l") || is("p"))
+    return LINE_SKIPPED;
+  if (is("usemtl"))
+    return LINE_MATERIAL;
+  if (is("mtllib"))
+    return LINE_LIBRARY;
+  if (is("o") || is("g"))
+    return LINE_GROUP;
+  return LINE_OTHER;
+}
+
+struct Corner {
+  int v, vt, vn; // 0-based, -1 if absent
+  bool operator==(const Corner &other) const {
+    return v == other.v && vt == other.vt && vn == other.vn;
+  }
+};
+struct CornerHash {
+  size_t operator()(const Corner &c) const {
+    return size_t(c.v) * 73856093u ^ size_t(c.vt) * 19349663u ^
+           size_t(c.vn) * 83492791u;
+  }
+};
+
+// state changes between faces; face is the chunk's face count at the time
+struct Event {
+  size_t face;
+  LineKind kind; // LINE_MATERIAL, LINE_LIBRARY or LINE_GROUP
+  string name;
+};
+
+struct Chunk {
+  const char *begin, *end;
+  // elements in earlier chunks, so indices resolve while parsing
+  size_t positionBase = 0, texCoordBase = 0, normalBase = 0;
+  size_t positionCount = 0, texCoordCount = 0, normalCount = 0;
+  vector<glm::vec3> positions, normals;
+  vector<glm::vec2> texCoords;
+  vector<Corner> corners;
+  vector<unsigned int> faceStarts; // into corners, plus the end
+  vector<Event> events;
+  unsigned int skipped = 0; // lines, points and broken faces
+};
+
+void countChunk(Chunk &chunk) {
+  forEachLine(chunk.begin, chunk.end, [&](const char *p, const char *end) {
+    switch (classify(p, end)) {
+    case LINE_POSITION: chunk.positionCount++; break;
+    case LINE_TEXCOORD: chunk.texCoordCount++; break;
+    case LINE_NORMAL: chunk.normalCount++; break;
+    default: break;
+    }
+  });
+}
+
+void parseFace(Chunk &chunk, const char *p, const char *end) {
+  size_t first = chunk.corners.size();
+  size_t positions = chunk.positionBase + chunk.positions.size(),
+         texCoords = chunk.texCoordBase + chunk.texCoords.size(),
+         normals = chunk.normalBase + chunk.normals.size();
+  while ((p = skipSpace(p, end)) < end) {
+    Corner corner{-1, -1, -1};
+    long long index;
+    p = parseIndex(p, end, index);
+    corner.v = resolveIndex(index, positions);
+    if (p < end && *p == '/') {
+      p++;
+      if (p < end && *p != '/') {
+        p = parseIndex(p, end, index);
+        corner.vt = resolveIndex(index, texCoords);
+      }
+      if (p < end && *p == '/') {
+        p = parseIndex(p + 1, end, index);
+        corner.vn = resolveIndex(index, normals);
+      }
+    }
+    while (p < end && !isSpace(*p))
+      p++;
+    if (corner.v < 0) {
+      chunk.corners.resize(first);
+      chunk.skipped++;
+      return;
+    }
+    chunk.corners.push_back(corner);
+  }
+  if (chunk.corners.size() - first < 3) {
+    chunk.corners.resize(first);
+    chunk.skipped++;
+    return;
+  }
+  chunk.faceStarts.push_back(first);
+}
+
+void parseChunk(Chunk &chunk) {
+  chunk.positions.reserve(chunk.positionCount);
+  chunk.texCoords.reserve(chunk.texCoordCount);
+  chunk.normals.reserve(chunk.normalCount);
+  forEachLine(chunk.begin, chunk.end, [&](const char *p, const char *end) {
+    LineKind kind = classify(p, end);
+    switch (kind) {
+    case LINE_POSITION: {
+      glm::vec3 v;
+      p = parseFloat(p, end, v.x);
+      p = parseFloat(p, end, v.y);
+      parseFloat(p, end, v.z);
+      chunk.positions.push_back(v);
+      break;
+    }
+    case LINE_TEXCOORD: {
+      glm::vec2 t;
+      p = parseFloat(p, end, t.x);
+      parseFloat(p, end, t.y);
+      chunk.texCoords.push_back(t);
+      break;
+    }
+    case LINE_NORMAL: {
+      glm::vec3 n;
+      p = parseFloat(p, end, n.x);
+      p = parseFloat(p, end, n.y);
+      parseFloat(p, end, n.z);
+      chunk.normals.push_back(n);
+      break;
+    }
+    case LINE_FACE:
+      parseFace(chunk, p, end);
+      break;
+    case LINE_SKIPPED:
+      chunk.skipped++;
+      break;
+    case LINE_MATERIAL:
+    case LINE_LIBRARY:
+    case LINE_GROUP:
+      chunk.events.push_back(
+          {chunk.faceStarts.size(), kind, restOfLine(p, end)});
+      break;
+    default:
+      break;
+    }
+  });
+  chunk.faceStarts.push_back(chunk.corners.size());
+}
+
+// The file of a texture statement, after any options (-bm 0.5 file.png).
+// File names may contain spaces, so it is the rest of the line.
+string textureFile(const char *p, const char *end) {
+  static const pair<const char *, int> OPTIONS[] = {
+      {"-blendu", 1}, {"-blendv", 1}, {"-boost", 1}, {"-cc", 1},
+      {"-clamp", 1},  {"-imfchan", 1}, {"-mm", 2},   {"-o", 3},
+      {"-s", 3},      {"-t", 3},      {"-texres", 1}, {"-bm", 1},
+      {"-type", 1}};
+  while ((p = skipSpace(p, end)) < end && *p == '-') {
+    const char *word = p;
+    while (p < end && !isSpace(*p))
+      p++;
+    int arguments = 0;
+    for (auto &option : OPTIONS)
+      if (size_t(p - word) == strlen(option.first) &&
+          memcmp(word, option.first, p - word) == 0)
+        arguments = option.second;
+    // -o, -s and -t take one to three numbers
+    for (int i = 0; i < arguments; i++) {
+      p = skipSpace(p, end);
+      if (arguments == 3 && i > 0 &&
+          !(p < end && (isDigit(*p) || *p == '-' || *p == '.')))
+        break;
+      while (p < end && !isSpace(*p))
+        p++;
+    }
+  }
+  return restOfLine(p, end);
+}
+
+// appends the materials of an MTL file: their names and texture references
+// in Model::loadMaterial's order (diffuse, specular, normal, height)
+void readMaterialLibrary(const string &path, vector<string> &names,
+                         vector<vector<Texture>> &textures) {
+  ifstream file(path, ios::binary);
+  if (!file) {
+    cout << "::Warning:: Can't open material library " << path << endl;
+    return;
+  }
+  static const char *TYPES[4] = {"texture_diffuse", "texture_specular",
+                                 "texture_normal", "texture_height"};
+  vector<vector<Texture>> slots[4];
+  string line;
+  while (getline(file, line)) {
+    const char *p = line.data(), *end = p + line.size();
+    p = skipSpace(p, end);
+    const char *wordEnd = p;
+    while (wordEnd < end && !isSpace(*wordEnd))
+      wordEnd++;
+    string word(p, wordEnd);
+    for (auto &c : word)
+      c = char(tolower(c));
+    if (word == "newmtl") {
+      names.push_back(restOfLine(wordEnd, end));
+      for (auto &slot : slots)
+        slot.emplace_back();
+      continue;
+    }
+    int slot = word == "map_kd"                                       ? 0
+               : word == "map_ks"                                     ? 1
+               : word == "map_bump" || word == "bump"                 ? 2
+               : word == "disp" || word == "map_disp"                 ? 3
+                                                                      : -1;
+    if (slot < 0 || slots[slot].empty())
+      continue;
+    Texture texture;
+    texture.id = 0;
+    texture.type = TYPES[slot];
+    texture.path = textureFile(wordEnd, end);
+    if (!texture.path.empty())
+      slots[slot].back().push_back(texture);
+  }
+  for (size_t m = 0; m < slots[0].size(); m++) {
+    textures.emplace_back();
+    for (auto &slot : slots)
+      textures.back().insert(textures.back().end(), slot[m].begin(),
+                             slot[m].end());
+  }
+}
+
+// faces [faceBegin, faceEnd) of a chunk
+struct Slice {
+  unsigned int chunk;
+  size_t faceBegin, faceEnd;
+};
+struct MeshRun {
+  unsigned int material;
+  vector<Slice> slices;
+};
+
+struct Attributes {
+  vector<glm::vec3> positions, normals;
+  vector<glm::vec2> texCoords;
+};
+
+glm::vec3 perpendicular(const glm::vec3 &n) {
+  return glm::normalize(glm::cross(
+      n, fabs(n.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f)));
+}
+
+// fans the faces of a run into triangles over deduplicated vertices and
+// fills in whatever attributes have to be generated
+void buildMesh(const vector<Chunk> &chunks, const Attributes &all,
+               const MeshRun &run, bool flipUVs, MeshData &mesh) {
+  mesh.materialIndex = run.material;
+  unordered_map<Corner, unsigned int, CornerHash> vertexOf;
+  vector<int> vertexPosition; // position index of every vertex
+  bool texCoords = false, normals = false;
+  auto vertex = [&](const Corner &c) {
+    auto inserted = vertexOf.emplace(c, (unsigned int)mesh.vertices.size());
+    if (inserted.second) {
+      Vertex v{};
+      v.Position = all.positions[c.v];
+      if (c.vt >= 0) {
+        v.TexCoords = all.texCoords[c.vt];
+        if (flipUVs)
+          v.TexCoords.y = 1.f - v.TexCoords.y;
+        texCoords = true;
+      }
+      if (c.vn >= 0) {
+        v.Normal = all.normals[c.vn];
+        normals = true;
+      }
+      mesh.vertices.push_back(v);
+      vertexPosition.push_back(c.v);
+    }
+    return inserted.first->second;
+  };
+  auto valid = [&](const Corner &c) {
+    return size_t(c.v) < all.positions.size() &&
+           (c.vt < 0 || size_t(c.vt) < all.texCoords.size()) &&
+           (c.vn < 0 || size_t(c.vn) < all.normals.size());
+  };
+
+  for (auto &slice : run.slices) {
+    const Chunk &chunk = chunks[slice.chunk];
+    for (size_t f = slice.faceBegin; f < slice.faceEnd; f++) {
+      const Corner *corners = &chunk.corners[chunk.faceStarts[f]];
+      size_t count = chunk.faceStarts[f + 1] - chunk.faceStarts[f];
+      if (!all_of(corners, corners + count, valid))
+        continue;
+      for (size_t k = 1; k + 1 < count; k++) {
+        mesh.indices.push_back(vertex(corners[0]));
+        mesh.indices.push_back(vertex(corners[k]));
+        mesh.indices.push_back(vertex(corners[k + 1]));
+      }
+    }
+  }
+  vector<Vertex> &vertices = mesh.vertices;
+  const vector<unsigned int> &indices = mesh.indices;
+
+  // area weighted smooth normals, shared by every vertex of a position
+  if (!normals) {
+    unordered_map<int, glm::vec3> sums;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      const Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]],
+                   &c = vertices[indices[i + 2]];
+      glm::vec3 n = glm::cross(b.Position - a.Position, c.Position - a.Position);
+      for (int k = 0; k < 3; k++)
+        sums[vertexPosition[indices[i + k]]] += n;
+    }
+    for (size_t v = 0; v < vertices.size(); v++) {
+      glm::vec3 n = sums[vertexPosition[v]];
+      float length = glm::length(n);
+      vertices[v].Normal = length > 0.f ? n / length : glm::vec3(0.f, 1.f, 0.f);
+    }
+  }
+
+  // tangent space from the texture coordinates, like CalcTangentSpace
+  if (!texCoords)
+    return;
+  vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.f)),
+      bitangents(vertices.size(), glm::vec3(0.f));
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    const Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]],
+                 &c = vertices[indices[i + 2]];
+    glm::vec3 e1 = b.Position - a.Position, e2 = c.Position - a.Position;
+    glm::vec2 d1 = b.TexCoords - a.TexCoords, d2 = c.TexCoords - a.TexCoords;
+    float r = d1.x * d2.y - d2.x * d1.y;
+    if (fabs(r) < 1e-12f)
+      continue;
+    glm::vec3 t = (e1 * d2.y - e2 * d1.y) / r;
+    glm::vec3 s = (e2 * d1.x - e1 * d2.x) / r;
+    for (int k = 0; k < 3; k++) {
+      tangents[indices[i + k]] += t;
+      bitangents[indices[i + k]] += s;
+    }
+  }
+  for (size_t v = 0; v < vertices.size(); v++) {
+    glm::vec3 n = vertices[v].Normal;
+    glm::vec3 t = tangents[v] - n * glm::dot(n, tangents[v]);
+    t = glm::length(t) > 1e-6f ? glm::normalize(t) : perpendicular(n);
+    glm::vec3 b = bitangents[v] - n * glm::dot(n, bitangents[v]);
+    b = glm::length(b) > 1e-6f ? glm::normalize(b) : glm::cross(n, t);
+    vertices[v].Tangent = t;
+    vertices[v].Bitangent = b;
+  }
+}
+} // namespace
+
+bool isObjPath(const string &path) {
+  size_t dot = path.find_last_of('.');
+  if (dot == string::npos || path.size() - dot != 4)
+    return false;
+  return tolower(path[dot + 1]) == 'o' && tolower(path[dot + 2]) == 'b' &&
+         tolower(path[dot + 3]) == 'j';
+}
+
+static string objDirectory(const string &path) {
+  size_t slash = path.find_last_of("/\\");
+  return slash == string::npos ? "." : path.substr(0, slash);
+}
+
+vector<string> objMaterialLibraries(const string &path, const char *text,
+                                    size_t size) {
+  vector<string> libraries;
+  string directory = objDirectory(path);
+  forEachLine(text, text + size, [&](const char *p, const char *end) {
+    // only lines starting with m can be one, skip the rest cheaply
+    p = skipSpace(p, end);
+    if (p < end && *p == 'm' && classify(p, end) == LINE_LIBRARY)
+      libraries.push_back(directory + '/' + restOfLine(p, end));
+  });
+  return libraries;
+}
+
+bool readObj(const string &path, bool flipUVs, vector<MeshData> &meshes,
+             map<unsigned int, vector<Texture>> &materials) {
+  auto start = chrono::steady_clock::now();
+  MappedFile file;
+  if (!file.open(path) || file.size() == 0) {
+    cout << "ERROR::OBJ:: Can't open " << path << endl;
+    return false;
+  }
+  string directory = objDirectory(path);
+  ThreadPool &pool = getWorkerPool();
+
+  // line aligned chunks, a few per thread so uneven ones even out
+  const char *text = (const char *)file.data(), *textEnd = text + file.size();
+  size_t chunkCount = max<size_t>(
+      1, min<size_t>(file.size() / OBJ_MIN_CHUNK_BYTES, (pool.size() + 1) * 4));
+  vector<Chunk> chunks(chunkCount);
+  const char *p = text;
+  for (size_t i = 0; i < chunkCount; i++) {
+    chunks[i].begin = p;
+    const char *split = max(p, text + file.size() * (i + 1) / chunkCount);
+    const char *newline =
+        i + 1 < chunkCount
+            ? (const char *)memchr(split, '\n', textEnd - split)
+            : nullptr;
+    p = newline ? newline + 1 : textEnd;
+    chunks[i].end = p;
+  }
+
+  // count first, so every chunk knows how many elements come before it and
+  // resolves relative indices while parsing
+  pool.parallelFor(chunkCount, [&](size_t i) { countChunk(chunks[i]); });
+  Attributes all;
+  size_t positions = 0, texCoords = 0, normals = 0;
+  for (auto &chunk : chunks) {
+    chunk.positionBase = positions;
+    chunk.texCoordBase = texCoords;
+    chunk.normalBase = normals;
+    positions += chunk.positionCount;
+    texCoords += chunk.texCoordCount;
+    normals += chunk.normalCount;
+  }
+  pool.parallelFor(chunkCount, [&](size_t i) { parseChunk(chunks[i]); });
+  auto parsed = chrono::steady_clock::now();
+
+  all.positions.reserve(positions);
+  all.texCoords.reserve(texCoords);
+  all.normals.reserve(normals);
+  unsigned int skipped = 0;
+  for (auto &chunk : chunks) {
+    all.positions.insert(all.positions.end(), chunk.positions.begin(),
+                         chunk.positions.end());
+    all.texCoords.insert(all.texCoords.end(), chunk.texCoords.begin(),
+                         chunk.texCoords.end());
+    all.normals.insert(all.normals.end(), chunk.normals.begin(),
+                       chunk.normals.end());
+    vector<glm::vec3>().swap(chunk.positions);
+    vector<glm::vec2>().swap(chunk.texCoords);
+    vector<glm::vec3>().swap(chunk.normals);
+    skipped += chunk.skipped;
+  }
+
+  // material libraries may be named anywhere in the file
+  vector<string> names;
+  vector<vector<Texture>> libraryTextures;
+  for (auto &chunk : chunks)
+    for (auto &event : chunk.events)
+      if (event.kind == LINE_LIBRARY)
+        readMaterialLibrary(directory + '/' + event.name, names,
+                            libraryTextures);
+  unordered_map<string, unsigned int> materialIndex;
+  for (size_t i = 0; i < names.size(); i++)
+    materialIndex.emplace(names[i], i);
+  // faces before any usemtl, or with an unknown one, get an empty material
+  const unsigned int defaultMaterial = names.size();
+
+  // a new mesh starts at every group and every change of material
+  vector<MeshRun> runs;
+  unsigned int material = defaultMaterial;
+  bool split = true;
+  for (unsigned int c = 0; c < chunkCount; c++) {
+    const Chunk &chunk = chunks[c];
+    size_t face = 0;
+    auto take = [&](size_t upTo) {
+      if (upTo <= face)
+        return;
+      if (split)
+        runs.push_back({material, {}});
+      split = false;
+      runs.back().slices.push_back({c, face, upTo});
+      face = upTo;
+    };
+    for (auto &event : chunk.events) {
+      take(event.face);
+      if (event.kind == LINE_GROUP)
+        split = true;
+      else if (event.kind == LINE_MATERIAL) {
+        auto it = materialIndex.find(event.name);
+        unsigned int next =
+            it == materialIndex.end() ? defaultMaterial : it->second;
+        split = split || next != material;
+        material = next;
+      }
+    }
+    take(chunk.faceStarts.size() - 1);
+  }
+
+  meshes.assign(runs.size(), MeshData());
+  pool.parallelFor(runs.size(), [&](size_t i) {
+    buildMesh(chunks, all, runs[i], flipUVs, meshes[i]);
+  });
+  // groups without a valid face
+  meshes.erase(remove_if(meshes.begin(), meshes.end(),
+                         [](const MeshData &mesh) {
+                           return mesh.indices.empty();
+                         }),
+               meshes.end());
+  for (auto &mesh : meshes)
+    if (!materials.count(mesh.materialIndex))
+      materials[mesh.materialIndex] = mesh.materialIndex < names.size()
+                                          ? libraryTextures[mesh.materialIndex]
+                                          : vector<Texture>();
+
+  size_t vertexCount = 0, triangleCount = 0;
+  for (auto &mesh : meshes) {
+    vertexCount += mesh.vertices.size();
+    triangleCount += mesh.indices.size() / 3;
+  }
+  if (skipped)
+    cout << "::Warning:: " << skipped
+         << " OBJ lines, points or broken faces skipped." << endl;
+  cout << "OBJ parsed: " << meshes.size() << " meshes, " << vertexCount
+       << " vertices, " << triangleCount << " triangles, parse "
+       << elapsedMs(start, parsed) << " ms, total "
+       << elapsedMs(start, chrono::steady_clock::now()) << " ms ("
+       << chunkCount << " chunks, " << pool.size() + 1 << " threads)"
+       << endl;
+  return true;
+}
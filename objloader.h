@@ -0,0 +1,34 @@
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include "mesh.h"
+
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// true for .obj paths
+bool isObjPath(const string &path);
+
+// paths of the material libraries (mtllib) the OBJ text at path refers to,
+// relative to the working directory like path
+vector<string> objMaterialLibraries(const string &path, const char *text,
+                                    size_t size);
+
+// Built-in Wavefront OBJ/MTL reader, the fast path Model takes instead of
+// Assimp for .obj files. The file is memory-mapped and cut into line-aligned
+// chunks that are parsed in parallel on the worker pool; the chunks are then
+// stitched together in order and every mesh is built in parallel again.
+//
+// Produces what Model::processMesh and loadMaterial would: one mesh per run
+// of faces with the same group and material, polygons fanned into
+// triangles, vertices deduplicated per mesh, tangents and bitangents like
+// aiProcess_CalcTangentSpace (smooth normals too if the file has none), and
+// per material the texture references of map_Kd, map_Ks, bump and disp as
+// texture_diffuse/specular/normal/height. flipUVs matches aiProcess_FlipUVs.
+// Returns false if the file can't be read.
+bool readObj(const string &path, bool flipUVs, vector<MeshData> &meshes,
+             map<unsigned int, vector<Texture>> &materials);
+
+#endif
@@ -8,6 +8,8 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 class Shader {
 public:
@@ -176,4 +178,23 @@ private:
     }
   }
 };
+
+// Something looked up per program the first time that program asks for it,
+// usually a set of uniform locations (-1 where the program has none).
+template <typename T> class ProgramCache {
+public:
+  // the entry of program, made by lookup(program) if there is none yet
+  template <typename Lookup>
+  const T &get(unsigned int program, Lookup lookup) {
+    // a handful of programs at most, a linear scan beats any map
+    for (auto &entry : entries)
+      if (entry.first == program)
+        return entry.second;
+    entries.emplace_back(program, lookup(program));
+    return entries.back().second;
+  }
+
+private:
+  std::vector<std::pair<unsigned int, T>> entries;
+};
 #endif
\ No newline at end of file
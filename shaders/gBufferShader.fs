@@ -20,15 +20,49 @@ struct Material {
   int specular_c;
   int normal_c;
   int height_c;
+  // with arrays, each slot has at most one texture, found at its layer
+  bool arrays;
+  ivec4 layers; // diffuse, specular, normal, height
 };
 
 uniform Material material;
+// units match MATERIAL_ARRAY_FIRST_UNIT in material.h
+layout(binding = 12) uniform sampler2DArray diffuseArray;
+layout(binding = 13) uniform sampler2DArray specularArray;
+layout(binding = 14) uniform sampler2DArray normalArray;
+layout(binding = 15) uniform sampler2DArray heightArray;
 uniform float height_scale = 0.05;
 
+vec4 diffuseAt(int i, vec2 texCoords) {
+  if (material.arrays)
+    return texture(diffuseArray, vec3(texCoords, material.layers.x));
+  return texture(material.diffuse[i], texCoords);
+}
+
+vec4 specularAt(int i, vec2 texCoords) {
+  if (material.arrays)
+    return texture(specularArray, vec3(texCoords, material.layers.y));
+  return texture(material.specular[i], texCoords);
+}
+
+// normal maps may be two channel (BC5), so z is rebuilt from xy
+vec3 normalAt(int i, vec2 texCoords) {
+  vec2 xy;
+  if (material.arrays)
+    xy = texture(normalArray, vec3(texCoords, material.layers.z)).rg;
+  else
+    xy = texture(material.normal[i], texCoords).rg;
+  xy = xy * 2.0 - 1.0;
+  return vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+}
+
 float getHeightAt(vec2 texCoords) {
   float height = 0.;
   for (int i = 0; i < material.height_c; i++) {
-    height += texture(material.height[i], texCoords).r;
+    if (material.arrays)
+      height += texture(heightArray, vec3(texCoords, material.layers.w)).r;
+    else
+      height += texture(material.height[i], texCoords).r;
   }
   return height;
 }
@@ -86,21 +120,20 @@ void main() {
   vec2 texCoords = ParallaxMapping(TexCoords, viewDir);
 
   for (int i = 0; i < material.diffuse_c; i++) {
-    albedo += texture(material.diffuse[i], texCoords);
+    albedo += diffuseAt(i, texCoords);
   }
   if (albedo.a < 0.1) {
     discard;
   }
   for (int i = 0; i < material.specular_c; i++) {
-    spec += texture(material.specular[i], texCoords);
+    spec += specularAt(i, texCoords);
   }
   for (int i = 0; i < material.normal_c; i++) {
-    normal += texture(material.normal[i], texCoords).rgb;
+    normal += normalAt(i, texCoords);
   }
   if (material.normal_c == 0) {
-    normal = vec3(0.5, 0.5, 1.);
+    normal = vec3(0., 0., 1.);
   }
-  normal = 2.0 * normal - 1.0;
   normal = normalize(TBN * normal);
 
   gPosition = vec4(FragPos, 1.);
@@ -2,7 +2,10 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
-layout(location = 3) in vec3 aTangent;
+// full layout: xyz tangent, w defaults to 1 (glTF: bitangent sign). compact
+// layout (CompactVertex in vertex.h): xy octahedral tangent, z bitangent
+// sign, w = 0.
+layout(location = 3) in vec4 aTangent;
 layout(location = 4) in vec3 aBitangent;
 
 out vec3 FragPos;
@@ -15,18 +18,68 @@ uniform mat4 view;
 uniform mat4 projection;
 uniform vec3 viewPos;
 
+// skinned meshes (see SkinVertex in vertex.h): three uints per vertex in the
+// skin stream, four 8-bit joints and four unorm16 weights, and the joint
+// matrices of every instance posed this frame back to back
+layout(std430, binding = 0) readonly buffer SkinStream { uint skinStream[]; };
+layout(std430, binding = 1) readonly buffer JointMatrices {
+  mat4 jointMatrices[];
+};
+uniform bool skinned;
+uniform int skinBase;  // gl_VertexID + skinBase is the vertex's skin
+uniform int jointBase; // first matrix of the instance
+
+mat4 skinMatrix() {
+  uint v = uint(gl_VertexID + skinBase) * 3u;
+  uint joints = skinStream[v];
+  vec2 w01 = unpackUnorm2x16(skinStream[v + 1u]);
+  vec2 w23 = unpackUnorm2x16(skinStream[v + 2u]);
+  return w01.x * jointMatrices[jointBase + int(joints & 0xFFu)] +
+         w01.y * jointMatrices[jointBase + int((joints >> 8) & 0xFFu)] +
+         w23.x * jointMatrices[jointBase + int((joints >> 16) & 0xFFu)] +
+         w23.y * jointMatrices[jointBase + int(joints >> 24)];
+}
+
+vec3 octDecode(vec2 e) {
+  vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return normalize(n);
+}
+
 void main() {
-  gl_Position = projection * view * model * vec4(aPos, 1.0);
+  vec3 normal = aNormal;
+  vec3 tangent = aTangent.xyz;
+  float bitangentSign = aTangent.w < 0.0 ? -1.0 : 1.0;
+  if (aTangent.w == 0.0) {
+    // compact layout: normals arrive as two snorm components in aNormal.xy
+    normal = octDecode(aNormal.xy);
+    tangent = octDecode(aTangent.xy);
+    bitangentSign = aTangent.z < 0.0 ? -1.0 : 1.0;
+  }
+  // glTF primitives without tangents leave the attribute at (0, 0, 0, 1)
+  if (dot(tangent, tangent) == 0.0)
+    tangent = cross(normal, abs(normal.x) < 0.9 ? vec3(1.0, 0.0, 0.0)
+                                                : vec3(0.0, 1.0, 0.0));
+  vec4 position = vec4(aPos, 1.0);
+  if (skinned) {
+    mat4 skin = skinMatrix();
+    position = skin * position;
+    normal = mat3(skin) * normal;
+    tangent = mat3(skin) * tangent;
+  }
+
+  gl_Position = projection * view * model * position;
 
   mat3 normalMatrix = transpose(inverse(mat3(model)));
-  FragPos = vec3(model * vec4(aPos, 1.0));
+  FragPos = vec3(model * position);
   TexCoords = aTexCoords;
 
   // Caculate TBN Matrix
-  vec3 T = normalize(normalMatrix * aTangent);
-  vec3 N = normalize(normalMatrix * aNormal);
+  vec3 T = normalize(normalMatrix * tangent);
+  vec3 N = normalize(normalMatrix * normal);
   T = normalize(T - dot(T, N) * N);
-  vec3 B = cross(N, T);
+  vec3 B = cross(N, T) * bitangentSign;
   TBN = mat3(T, B, N);
 
   mat3 tTBN = transpose(mat3(T, B, N));
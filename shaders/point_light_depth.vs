@@ -3,7 +3,30 @@ layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
 
+// skinning, same as in gBufferShader.vs
+layout(std430, binding = 0) readonly buffer SkinStream { uint skinStream[]; };
+layout(std430, binding = 1) readonly buffer JointMatrices {
+  mat4 jointMatrices[];
+};
+uniform bool skinned;
+uniform int skinBase;
+uniform int jointBase;
+
+mat4 skinMatrix() {
+  uint v = uint(gl_VertexID + skinBase) * 3u;
+  uint joints = skinStream[v];
+  vec2 w01 = unpackUnorm2x16(skinStream[v + 1u]);
+  vec2 w23 = unpackUnorm2x16(skinStream[v + 2u]);
+  return w01.x * jointMatrices[jointBase + int(joints & 0xFFu)] +
+         w01.y * jointMatrices[jointBase + int((joints >> 8) & 0xFFu)] +
+         w23.x * jointMatrices[jointBase + int((joints >> 16) & 0xFFu)] +
+         w23.y * jointMatrices[jointBase + int(joints >> 24)];
+}
+
 void main()
 {
-    gl_Position = model * vec4(aPos, 1.0);
+    vec4 position = vec4(aPos, 1.0);
+    if (skinned)
+        position = skinMatrix() * position;
+    gl_Position = model * position;
 }  
\ No newline at end of file
@@ -7,14 +7,20 @@ uniform vec3 lightDir;
 struct Material {
   sampler2D diffuse[MATERIAL_MAX_COUNT];
   int diffuse_c;
+  bool arrays;
+  ivec4 layers;
 };
 
 uniform Material material;
+// unit matches MATERIAL_ARRAY_FIRST_UNIT in material.h
+layout(binding = 12) uniform sampler2DArray diffuseArray;
 
 void main() {
   float alpha = 0.;
   for (int i = 0; i < material.diffuse_c; i++)
-    alpha += texture(material.diffuse[i], TexCoords).a;
+    alpha += material.arrays
+                 ? texture(diffuseArray, vec3(TexCoords, material.layers.x)).a
+                 : texture(material.diffuse[i], TexCoords).a;
   if (alpha < 0.1)
     discard;
   gl_FragDepth = gl_FragCoord.z;
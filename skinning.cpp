@@ -0,0 +1,79 @@
+#include "skinning.h"
+#include "threadpool.h"
+
+#include <algorithm>
+using namespace std;
+
+Skinning skinning;
+
+void Skinning::add(SkinnedInstance *instance) { instances.push_back(instance); }
+
+void Skinning::remove(SkinnedInstance *instance) {
+  instances.erase(std::remove(instances.begin(), instances.end(), instance),
+                  instances.end());
+  posed.erase(std::remove(posed.begin(), posed.end(), instance), posed.end());
+}
+
+void Skinning::update(float deltaTime) {
+  // lay the instances out back to back in this frame's buffer
+  posed.clear();
+  size_t joints = 0;
+  for (auto *instance : instances) {
+    instance->jointBase = -1;
+    if (!instance->skeleton || instance->skeleton->empty())
+      continue;
+    if (playing)
+      instance->time += deltaTime * instance->speed;
+    instance->jointBase = int(joints);
+    joints += instance->skeleton->joints.size();
+    posed.push_back(instance);
+  }
+  palette.resize(joints);
+  if (!joints)
+    return;
+
+  getWorkerPool().parallelFor(posed.size(), [&](size_t i) {
+    const SkinnedInstance &instance = *posed[i];
+    const vector<AnimationClip> &clips = instance.skeleton->clips;
+    const AnimationClip *clip =
+        instance.clip >= 0 && instance.clip < int(clips.size())
+            ? &clips[instance.clip]
+            : nullptr;
+    evaluatePose(*instance.skeleton, clip, instance.time,
+                 &palette[instance.jointBase]);
+  });
+
+  // orphan the old storage so the upload doesn't wait on last frame's draws
+  size_t bytes = joints * sizeof(glm::mat4);
+  if (!buffer)
+    glGenBuffers(1, &buffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+  if (bytes > capacity)
+    capacity = max(bytes, capacity * 2);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, palette.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, JOINT_MATRIX_BINDING, buffer);
+}
+
+namespace {
+struct SkinLocations {
+  GLint skinned, skinBase, jointBase;
+};
+} // namespace
+
+void setSkinUniforms(const Shader &shader, bool skinned, int skinBase,
+                     int jointBase) {
+  static ProgramCache<SkinLocations> programs;
+  const SkinLocations &locations =
+      programs.get(shader.ID, [](unsigned int program) {
+        return SkinLocations{glGetUniformLocation(program, "skinned"),
+                             glGetUniformLocation(program, "skinBase"),
+                             glGetUniformLocation(program, "jointBase")};
+      });
+  glUniform1i(locations.skinned, skinned);
+  if (skinned) {
+    glUniform1i(locations.skinBase, skinBase);
+    glUniform1i(locations.jointBase, jointBase);
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include <glad/glad.h>
+
+#include "animation.h"
+#include "shader_s.h"
+#include "vertex.h"
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+// animation state of one drawn copy of a skinned model
+struct SkinnedInstance {
+  const Skeleton *skeleton = nullptr; // posed once it has joints
+  int clip = 0; // -1 holds the bind pose
+  float time = 0.f; // seconds into the clip
+  float speed = 1.f;
+  int jointBase = -1; // first matrix of this frame's pose, -1 if unposed
+};
+
+// Poses every registered instance once per frame on the worker pool and
+// uploads all joint matrices with a single buffer update. The buffer stays
+// bound at JOINT_MATRIX_BINDING, so the shadow passes and the G-buffer pass
+// read the same matrices.
+class Skinning {
+public:
+  bool playing = true; // advance clips, or keep showing the current pose
+
+  void add(SkinnedInstance *instance);
+  void remove(SkinnedInstance *instance);
+
+  // advances and poses the instances and uploads their matrices. GL thread
+  // only, once per frame before anything is drawn.
+  void update(float deltaTime);
+
+  // instances and joint matrices posed this frame
+  unsigned int posedInstances() const { return posed.size(); }
+  size_t jointCount() const { return palette.size(); }
+
+private:
+  vector<SkinnedInstance *> instances;
+  vector<SkinnedInstance *> posed;
+  vector<glm::mat4> palette;
+  unsigned int buffer = 0;
+  size_t capacity = 0; // bytes
+};
+
+extern Skinning skinning;
+
+// points the shader at a skinned mesh's skin stream (see
+// GeometryArena::skinBase) and its instance's joint matrices, or turns
+// skinning off. Uniform locations are cached per program.
+void setSkinUniforms(const Shader &shader, bool skinned, int skinBase = 0,
+                     int jointBase = 0);
+
+#endif
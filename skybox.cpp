@@ -0,0 +1,153 @@
+#include "skybox.h"
+#include "image_decode.h"
+#include "texture_loader.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+using namespace std;
+
+SkyboxLoader skyboxLoader;
+
+namespace {
+// in GL_TEXTURE_CUBE_MAP_POSITIVE_X order
+const char *FACE_NAMES[6] = {"right", "left", "top", "bottom", "front", "back"};
+const char *FACE_EXTENSIONS[] = {".jpg", ".png", ".tga"};
+
+bool findFaces(const string &directory, string faces[6]) {
+  for (const char *extension : FACE_EXTENSIONS) {
+    bool found = true;
+    for (int i = 0; i < 6 && found; i++) {
+      faces[i] = directory + '/' + FACE_NAMES[i] + extension;
+      found = filesystem::exists(faces[i]);
+    }
+    if (found)
+      return true;
+  }
+  return false;
+}
+} // namespace
+
+bool loadCubemapImage(const string &directory, bool s3tc, TextureImage &image) {
+  string faces[6];
+  if (!findFaces(directory, faces)) {
+    cout << "::Warning:: No cube map faces in: " << directory << endl;
+    return false;
+  }
+  ThreadPool &pool = getWorkerPool();
+
+  // the packed file depends on all six sources
+  uint32_t salt = textureCacheSalt(TEXTURE_COLOR, true, s3tc);
+  uint64_t keys[6];
+  pool.parallelFor(6, [&](size_t i) {
+    keys[i] = textureCacheKey(textureSourceHash(faces[i]), salt);
+  });
+  uint64_t key = 0;
+  if (find(keys, keys + 6, 0) == keys + 6)
+    key = hashBytes(keys, sizeof(keys));
+  string cachePath = textureCachePath(directory, salt);
+  if (key && readTextureCache(cachePath, key, image) && image.faces == 6)
+    return true;
+
+  auto start = chrono::steady_clock::now();
+  DecodedImage decoded[6];
+  bool decodedOk[6];
+  pool.parallelFor(6, [&](size_t i) {
+    decodedOk[i] = decodeImage(faces[i], decoded[i]);
+  });
+  for (int i = 0; i < 6; i++)
+    if (!decodedOk[i]) {
+      cout << "Cubemap texture failed to load at path: " << faces[i] << endl;
+      return false;
+    }
+  int size = decoded[0].width, channels = decoded[0].channels;
+  TextureCodec codec = CODEC_NONE;
+  for (DecodedImage &face : decoded) {
+    if (face.width != size || face.height != size ||
+        face.channels != channels) {
+      cout << "::Warning:: Cube map faces differ in size or channels: "
+           << directory << endl;
+      return false;
+    }
+    // one face with alpha makes them all BC3
+    codec = TextureCodec(
+        max<int>(codec, chooseTextureCodec(TEXTURE_COLOR, channels,
+                                           face.pixels.get(),
+                                           size_t(size) * size, s3tc)));
+  }
+
+  TextureImage built[6];
+  pool.parallelFor(6, [&](size_t i) {
+    buildTextureImage(decoded[i].pixels.get(), size, size, channels, codec,
+                      true, false, built[i]);
+  });
+  image = move(built[0]);
+  image.faces = 6;
+  image.data.reserve(image.byteSize());
+  for (int i = 1; i < 6; i++)
+    image.data.insert(image.data.end(), built[i].data.begin(),
+                      built[i].data.end());
+  cout << "Cubemap cached: " << directory << " ("
+       << textureCodecName(codec) << ", " << image.levels.size()
+       << " levels, " << image.uncompressedBytes() / 1048576.0 << " -> "
+       << image.gpuBytes() / 1048576.0 << " MB, "
+       << elapsedMs(start, chrono::steady_clock::now()) << " ms)" << endl;
+  if (key)
+    writeTextureCache(cachePath, key, image);
+  return true;
+}
+
+void SkyboxLoader::request(const string &directory) {
+  // asked for again while still on its way: keep the load going
+  if (job && job->directory == directory)
+    return;
+  // the worker of a dropped set finishes into its own job and is ignored
+  if (job && job->texture)
+    glDeleteTextures(1, &job->texture);
+  requestedDirectory = directory;
+  job = make_shared<Job>();
+  job->directory = directory;
+  job->s3tc = textureCompressionS3TC();
+  getWorkerPool().submit([load = job] {
+    load->loaded = loadCubemapImage(load->directory, load->s3tc, load->image);
+    load->done = true;
+  });
+}
+
+void SkyboxLoader::update(size_t uploadBytes) {
+  if (!job || !job->done)
+    return;
+  if (!job->loaded) {
+    cout << "::Warning:: Skybox failed to load: " << job->directory << endl;
+    job = nullptr;
+    return;
+  }
+  const TextureImage &image = job->image;
+  if (!job->texture)
+    glGenTextures(1, &job->texture);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, job->texture);
+  size_t uploaded = 0;
+  for (; job->face < 6 && uploaded < uploadBytes; job->face++) {
+    uploadTextureLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + job->face, image,
+                        image.bytes() + job->face * image.faceBytes());
+    uploaded += image.faceBytes();
+  }
+  if (job->face == 6) {
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL,
+                    image.levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    if (current)
+      glDeleteTextures(1, &current);
+    current = job->texture;
+    job = nullptr;
+  }
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
@@ -0,0 +1,57 @@
+#ifndef SKYBOX_H
+#define SKYBOX_H
+
+#include <glad/glad.h>
+
+#include "config.h"
+#include "texture_cache.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+using namespace std;
+
+// Reads a skybox set, the six faces directory/right, left, top, bottom,
+// front and back (.jpg, .png or .tga), as one cube map image with mip
+// chains. The faces are decoded and filtered concurrently, and the result is
+// cached as a single DDS cube map next to the directory
+// (skybox.<salt>.dds) that later runs map straight in. s3tc as for
+// loadTextureImage; safe on workers.
+bool loadCubemapImage(const string &directory, bool s3tc, TextureImage &image);
+
+// Loads skybox sets on the worker pool and uploads them a few faces per
+// frame, so switching sets never stalls. The previous set stays bound until
+// the new one is complete.
+class SkyboxLoader {
+public:
+  // starts loading a set, dropping a different one that is still on its way
+  void request(const string &directory);
+  // uploads faces of an arrived set, up to uploadBytes of them, and swaps
+  // it in once all six are there. GL thread only, once per frame.
+  void update(size_t uploadBytes = TEXTURE_UPLOAD_BUDGET_MB << 20);
+
+  // 0 until the first set has arrived
+  unsigned int texture() const { return current; }
+  // the set last asked for, which may still be loading
+  const string &requested() const { return requestedDirectory; }
+  bool loading() const { return job != nullptr; }
+
+private:
+  struct Job {
+    string directory;
+    bool s3tc;
+    bool loaded = false;
+    TextureImage image;
+    atomic<bool> done{false};
+    unsigned int texture = 0; // created with the first face upload
+    int face = 0;             // next face to upload
+  };
+
+  shared_ptr<Job> job;
+  unsigned int current = 0;
+  string requestedDirectory;
+};
+
+extern SkyboxLoader skyboxLoader;
+
+#endif
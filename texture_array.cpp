@@ -0,0 +1,79 @@
+#include "texture_array.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+using namespace std;
+
+TextureArrayStats textureArrayStats;
+
+static unordered_map<unsigned int, unsigned int> layersByArray;
+
+unordered_map<unsigned int, TextureLayer>
+packTextureArrays(const vector<unsigned int> &textures,
+                  vector<unsigned int> &arrays) {
+  // group by what an array needs to share: size, internal format and levels
+  map<tuple<int, int, int, int>, vector<unsigned int>> groups;
+  for (unsigned int id : textures) {
+    GLint width = 0, height = 0, format = 0;
+    glBindTexture(GL_TEXTURE_2D, id);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT,
+                             &format);
+    if (width <= 0 || height <= 0)
+      continue;
+    // uploads build full mip chains; anything without one keeps level 0
+    int levels = 1;
+    for (int size = max(width, height); size > 1; size /= 2)
+      levels++;
+    GLint lastLevelWidth = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, levels - 1, GL_TEXTURE_WIDTH,
+                             &lastLevelWidth);
+    if (lastLevelWidth == 0)
+      levels = 1;
+    groups[{width, height, format, levels}].push_back(id);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  unordered_map<unsigned int, TextureLayer> layers;
+  for (auto &[key, members] : groups) {
+    auto [width, height, format, levels] = key;
+    unsigned int array;
+    glGenTextures(1, &array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format, width, height,
+                   members.size());
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                    levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    for (size_t layer = 0; layer < members.size(); layer++) {
+      for (int level = 0; level < levels; level++)
+        glCopyImageSubData(members[layer], GL_TEXTURE_2D, level, 0, 0, 0,
+                           array, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                           max(width >> level, 1), max(height >> level, 1),
+                           1);
+      layers[members[layer]] = {array, int(layer)};
+    }
+    arrays.push_back(array);
+    layersByArray[array] = members.size();
+    textureArrayStats.arrays++;
+    textureArrayStats.layers += members.size();
+  }
+  return layers;
+}
+
+void deleteTextureArrays(vector<unsigned int> &arrays) {
+  for (unsigned int array : arrays) {
+    textureArrayStats.arrays--;
+    textureArrayStats.layers -= layersByArray[array];
+    layersByArray.erase(array);
+  }
+  if (!arrays.empty())
+    glDeleteTextures(arrays.size(), arrays.data());
+  arrays.clear();
+}
@@ -0,0 +1,34 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// where a texture ended up after packing
+struct TextureLayer {
+  unsigned int array = 0;
+  int layer = -1;
+};
+
+// Copies 2D textures, all mip levels included, into GL_TEXTURE_2D_ARRAY
+// objects: one array per size, internal format and mip level count, one
+// layer per texture. Returns the layer of every texture and appends the new
+// arrays to arrays. The source textures are left alone.
+unordered_map<unsigned int, TextureLayer>
+packTextureArrays(const vector<unsigned int> &textures,
+                  vector<unsigned int> &arrays);
+
+// deletes arrays made by packTextureArrays and clears the list
+void deleteTextureArrays(vector<unsigned int> &arrays);
+
+// live arrays and the layers they hold, for the debug window
+struct TextureArrayStats {
+  unsigned int arrays = 0;
+  unsigned int layers = 0;
+};
+extern TextureArrayStats textureArrayStats;
+
+#endif
@@ -0,0 +1,498 @@
+#include "texture_cache.h"
+#include "bcn.h"
+#include "image_decode.h"
+#include "mapped_file.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+// S3TC is an extension, glad only has the core RGTC names
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace {
+// bump whenever the encoders, the mip filter or the layout change
+const uint32_t TEXTURE_CACHE_VERSION = 2;
+const uint32_t TEXTURE_CACHE_TAG = 0x544c474f; // "OGLT"
+
+const uint32_t DDS_MAGIC = 0x20534444;       // "DDS "
+const uint32_t DDS_FOURCC_DX10 = 0x30315844; // "DX10"
+const uint32_t DDS_MISC_TEXTURECUBE = 0x4;
+// all six faces present
+const uint32_t DDS_CAPS2_CUBEMAP_ALL = 0x200 | 0xfc00;
+
+struct DDSPixelFormat {
+  uint32_t size, flags, fourCC, rgbBitCount;
+  uint32_t rMask, gMask, bMask, aMask;
+};
+
+// reserved1 holds the tag, version, key and source channels
+struct DDSHeader {
+  uint32_t size, flags, height, width, pitchOrLinearSize, depth, mipMapCount;
+  uint32_t reserved1[11];
+  DDSPixelFormat format;
+  uint32_t caps, caps2, caps3, caps4, reserved2;
+};
+
+struct DDSHeaderDX10 {
+  uint32_t dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2;
+};
+
+const size_t DDS_HEADER_BYTES =
+    sizeof(uint32_t) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10);
+
+uint32_t dxgiFormat(TextureCodec codec, bool srgb, int channels) {
+  switch (codec) {
+  case CODEC_BC1: return srgb ? 72 : 71;
+  case CODEC_BC3: return srgb ? 78 : 77;
+  case CODEC_BC4: return 80;
+  case CODEC_BC5: return 83;
+  default: break;
+  }
+  // R8, R8G8 and R8G8B8A8; DXGI has no three channel format
+  if (channels == 1)
+    return 61;
+  if (channels == 2)
+    return 49;
+  return srgb ? 29 : 28;
+}
+
+size_t blockBytes(TextureCodec codec) {
+  return codec == CODEC_BC1 || codec == CODEC_BC4 ? 8 : 16;
+}
+
+size_t levelBytes(TextureCodec codec, int width, int height, int channels) {
+  if (codec == CODEC_NONE)
+    return size_t(width) * height * channels;
+  return size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes(codec);
+}
+
+// bytes of a full uncompressed mip chain, RGB counted as RGBA like drivers
+// store it (and like the cache does)
+size_t mipChainBytes(int width, int height, int channels) {
+  size_t texelBytes = channels == 3 ? 4 : channels;
+  size_t bytes = 0;
+  for (int w = width, h = height;; w = max(w / 2, 1), h = max(h / 2, 1)) {
+    bytes += size_t(w) * h * texelBytes;
+    if (w == 1 && h == 1)
+      break;
+  }
+  return bytes;
+}
+
+void encodeBlock(TextureCodec codec, const uint8_t block[64], uint8_t *out) {
+  switch (codec) {
+  case CODEC_BC1: encodeBC1Block(block, out); break;
+  case CODEC_BC3: encodeBC3Block(block, out); break;
+  case CODEC_BC4: encodeBC4Block(block, 4, out); break;
+  case CODEC_BC5: encodeBC5Block(block, out); break;
+  default: break;
+  }
+}
+
+float srgbToLinear(float value) {
+  return value <= 0.04045f ? value / 12.92f
+                           : pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float value) {
+  return value <= 0.0031308f ? value * 12.92f
+                             : 1.055f * pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+// Source texels of output texel i when halving an axis of n texels. Even
+// sizes average pairs; odd sizes take three texels with weights that give
+// every source texel the same share, so nothing is dropped or shifted.
+struct FilterTaps {
+  int first, count;
+  float weight[3];
+};
+
+FilterTaps filterTaps(int i, int n) {
+  if (n == 1)
+    return {0, 1, {1.f}};
+  if (n % 2 == 0)
+    return {2 * i, 2, {0.5f, 0.5f}};
+  int m = n / 2;
+  float scale = 1.f / n;
+  return {2 * i, 3, {(m - i) * scale, m * scale, (i + 1) * scale}};
+}
+
+// box filters a w x h RGBA level, read through fetch(texelIndex, channel),
+// into the next one
+template <class Fetch>
+void downsample(Fetch fetch, int w, int h, vector<float> &next) {
+  int nw = max(w / 2, 1), nh = max(h / 2, 1);
+  next.assign(size_t(nw) * nh * 4, 0.f);
+  getWorkerPool().parallelFor(nh, [&](size_t y) {
+    FilterTaps ty = filterTaps(int(y), h);
+    for (int x = 0; x < nw; x++) {
+      FilterTaps tx = filterTaps(x, w);
+      float *out = &next[(y * nw + x) * 4];
+      for (int j = 0; j < ty.count; j++)
+        for (int i = 0; i < tx.count; i++) {
+          size_t texel = size_t(ty.first + j) * w + tx.first + i;
+          float weight = ty.weight[j] * tx.weight[i];
+          for (int c = 0; c < 4; c++)
+            out[c] += weight * fetch(texel, c);
+        }
+    }
+  });
+}
+} // namespace
+
+GLenum TextureImage::internalFormat() const {
+  switch (codec) {
+  case CODEC_BC1:
+    return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+                : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case CODEC_BC3:
+    return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+                : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  case CODEC_BC4: return GL_COMPRESSED_RED_RGTC1;
+  case CODEC_BC5: return GL_COMPRESSED_RG_RGTC2;
+  default: break;
+  }
+  // one and two channel images have no sRGB formats
+  if (channels == 1)
+    return GL_R8;
+  if (channels == 2)
+    return GL_RG8;
+  if (channels == 3)
+    return srgb ? GL_SRGB8 : GL_RGB8;
+  return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+}
+
+size_t TextureImage::gpuBytes() const {
+  size_t bytes = 0;
+  for (auto &level : levels)
+    bytes += codec == CODEC_NONE && channels == 3
+                 ? size_t(level.width) * level.height * 4
+                 : level.size;
+  return bytes * faces;
+}
+
+size_t TextureImage::uncompressedBytes() const {
+  return mipChainBytes(width, height, channels) * faces;
+}
+
+const char *textureCodecName(TextureCodec codec) {
+  static const char *names[] = {"none", "BC1", "BC3", "BC4", "BC5"};
+  return names[codec];
+}
+
+bool textureCompressionS3TC() {
+  static int supported = -1;
+  if (supported < 0) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+    vector<GLint> formats(max(count, 0));
+    if (count > 0)
+      glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+    supported = find(formats.begin(), formats.end(),
+                     GLint(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)) != formats.end();
+    if (!supported)
+      cout << "::Warning:: No S3TC support, colour textures stay "
+              "uncompressed."
+           << endl;
+  }
+  return supported;
+}
+
+void buildTextureImage(const unsigned char *pixels, int width, int height,
+                       int channels, TextureCodec codec, bool srgb,
+                       bool normalMap, TextureImage &image) {
+  image = TextureImage();
+  image.width = width;
+  image.height = height;
+  // uncompressed levels are stored as they upload; RGB becomes RGBA
+  image.channels = codec == CODEC_NONE && channels == 3 ? 4 : channels;
+  // only BC1/BC3 and RGBA have sRGB variants
+  image.srgb = srgb && (codec == CODEC_BC1 || codec == CODEC_BC3 ||
+                        (codec == CODEC_NONE && channels >= 3));
+  image.codec = codec;
+
+  // RGBA copy of the source; missing channels are 0, missing alpha opaque.
+  // Two channel images (grey and alpha) end up in red and green like GL_RG.
+  vector<uint8_t> level(size_t(width) * height * 4, 0);
+  ThreadPool &pool = getWorkerPool();
+  pool.parallelFor(height, [&](size_t y) {
+    const unsigned char *in = pixels + y * width * channels;
+    uint8_t *out = &level[y * width * 4];
+    if (channels == 4)
+      memcpy(out, in, size_t(width) * 4);
+    else if (channels == 3)
+      expandToRGBA(in, out, width);
+    else
+      for (int x = 0; x < width; x++) {
+        for (int c = 0; c < channels; c++)
+          out[x * 4 + c] = in[x * channels + c];
+        out[x * 4 + 3] = 255;
+      }
+  });
+
+  // sRGB colour is averaged in linear space, else mips darken; alpha and
+  // data are linear already
+  float decode[256];
+  for (int i = 0; i < 256; i++)
+    decode[i] = image.srgb ? srgbToLinear(i / 255.f) : i / 255.f;
+  // levels after the first are filtered from the unquantized previous level
+  vector<float> linear, next;
+
+  for (int w = width, h = height;;) {
+    TextureLevel info{w, h, image.data.size(),
+                      levelBytes(codec, w, h, image.channels)};
+    image.data.resize(info.offset + info.size);
+    uint8_t *out = image.data.data() + info.offset;
+    if (codec == CODEC_NONE) {
+      for (size_t i = 0; i < size_t(w) * h; i++)
+        memcpy(out + i * image.channels, &level[i * 4], image.channels);
+    } else {
+      int blocksX = (w + 3) / 4, blocksY = (h + 3) / 4;
+      pool.parallelFor(blocksY, [&](size_t by) {
+        uint8_t block[64];
+        for (int bx = 0; bx < blocksX; bx++) {
+          // edge blocks repeat the last row and column
+          for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++) {
+              int sx = min(bx * 4 + x, w - 1),
+                  sy = min(int(by) * 4 + y, h - 1);
+              memcpy(block + (y * 4 + x) * 4,
+                     &level[(size_t(sy) * w + sx) * 4], 4);
+            }
+          encodeBlock(codec, block,
+                      out + (by * blocksX + bx) * blockBytes(codec));
+        }
+      });
+    }
+    image.levels.push_back(info);
+    if (w == 1 && h == 1)
+      break;
+
+    if (linear.empty())
+      downsample(
+          [&](size_t texel, int c) {
+            uint8_t value = level[texel * 4 + c];
+            return c < 3 ? decode[value] : value / 255.f;
+          },
+          w, h, next);
+    else
+      downsample([&](size_t texel, int c) { return linear[texel * 4 + c]; },
+                 w, h, next);
+    linear.swap(next);
+    w = max(w / 2, 1);
+    h = max(h / 2, 1);
+
+    level.resize(size_t(w) * h * 4);
+    pool.parallelFor(h, [&](size_t y) {
+      for (size_t i = y * w; i < (y + 1) * w; i++) {
+        float *texel = &linear[i * 4];
+        // averaged normals get shorter, point them back onto the sphere
+        if (normalMap && channels >= 3) {
+          float n[3], length2 = 0.f;
+          for (int c = 0; c < 3; c++) {
+            n[c] = texel[c] * 2.f - 1.f;
+            length2 += n[c] * n[c];
+          }
+          if (length2 > 1e-8f)
+            for (int c = 0; c < 3; c++)
+              texel[c] = n[c] / sqrt(length2) * 0.5f + 0.5f;
+        }
+        for (int c = 0; c < 4; c++) {
+          float value = c < 3 && image.srgb ? linearToSrgb(texel[c]) : texel[c];
+          level[i * 4 + c] =
+              uint8_t(min(max(value, 0.f), 1.f) * 255.f + 0.5f);
+        }
+      }
+    });
+  }
+}
+
+uint64_t textureSourceHash(const string &sourcePath) {
+  MappedFile source;
+  if (!source.open(sourcePath))
+    return 0;
+  return hashBytes(source.data(), source.size());
+}
+
+uint64_t textureCacheKey(uint64_t sourceHash, uint32_t salt) {
+  if (!sourceHash)
+    return 0;
+  uint32_t salts[2] = {salt, TEXTURE_CACHE_VERSION};
+  return hashBytes(salts, sizeof(salts), sourceHash);
+}
+
+bool readTextureCache(const string &path, uint64_t key, TextureImage &image) {
+  auto file = make_shared<MappedFile>();
+  if (!file->open(path) || file->size() < DDS_HEADER_BYTES)
+    return false;
+  uint32_t magic;
+  DDSHeader header;
+  DDSHeaderDX10 dx10;
+  memcpy(&magic, file->data(), sizeof(magic));
+  memcpy(&header, file->data() + sizeof(magic), sizeof(header));
+  memcpy(&dx10, file->data() + sizeof(magic) + sizeof(header), sizeof(dx10));
+  if (magic != DDS_MAGIC || header.size != sizeof(DDSHeader) ||
+      header.format.fourCC != DDS_FOURCC_DX10 ||
+      header.reserved1[0] != TEXTURE_CACHE_TAG ||
+      header.reserved1[1] != TEXTURE_CACHE_VERSION ||
+      header.reserved1[2] != uint32_t(key) ||
+      header.reserved1[3] != uint32_t(key >> 32) ||
+      dx10.resourceDimension != 3 || dx10.arraySize != 1 ||
+      (dx10.miscFlag & ~DDS_MISC_TEXTURECUBE) != 0 ||
+      header.width == 0 || header.height == 0 || header.width > 32768 ||
+      header.height > 32768 || header.mipMapCount == 0 ||
+      header.mipMapCount > 16)
+    return false;
+
+  TextureImage result;
+  result.channels = header.reserved1[4];
+  if (result.channels < 1 || result.channels > 4)
+    return false;
+  bool known = false;
+  for (int codec = CODEC_NONE; codec <= CODEC_BC5; codec++)
+    for (bool srgb : {true, false})
+      if (dxgiFormat(TextureCodec(codec), srgb, result.channels) ==
+          dx10.dxgiFormat) {
+        result.codec = TextureCodec(codec);
+        result.srgb = srgb;
+        known = true;
+      }
+  if (!known || (result.codec == CODEC_NONE && result.channels == 3))
+    return false;
+  result.width = header.width;
+  result.height = header.height;
+  result.faces = dx10.miscFlag & DDS_MISC_TEXTURECUBE ? 6 : 1;
+  size_t offset = 0;
+  for (int w = result.width, h = result.height;
+       result.levels.size() < header.mipMapCount;
+       w = max(w / 2, 1), h = max(h / 2, 1)) {
+    TextureLevel level{w, h, offset,
+                       levelBytes(result.codec, w, h, result.channels)};
+    result.levels.push_back(level);
+    offset += level.size;
+  }
+  if (offset * result.faces > file->size() - DDS_HEADER_BYTES)
+    return false;
+  // the levels are uploaded straight from the mapping
+  result.mapped = file->data() + DDS_HEADER_BYTES;
+  result.file = move(file);
+  image = move(result);
+  return true;
+}
+
+bool writeTextureCache(const string &path, uint64_t key,
+                       const TextureImage &image) {
+  if (image.levels.empty() || (image.faces != 1 && image.faces != 6) ||
+      (image.codec == CODEC_NONE && image.channels == 3))
+    return false;
+  DDSHeader header;
+  memset(&header, 0, sizeof(header));
+  header.size = sizeof(DDSHeader);
+  // caps, height, width, pixel format, mipmap count, linear size
+  header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+  header.height = image.height;
+  header.width = image.width;
+  header.pitchOrLinearSize = image.levels[0].size;
+  header.mipMapCount = image.levels.size();
+  header.reserved1[0] = TEXTURE_CACHE_TAG;
+  header.reserved1[1] = TEXTURE_CACHE_VERSION;
+  header.reserved1[2] = uint32_t(key);
+  header.reserved1[3] = uint32_t(key >> 32);
+  header.reserved1[4] = image.channels;
+  header.format.size = sizeof(DDSPixelFormat);
+  header.format.flags = 0x4; // fourCC
+  header.format.fourCC = DDS_FOURCC_DX10;
+  // texture, complex, mipmap
+  header.caps = 0x1000 | (image.levels.size() > 1 ? 0x8 | 0x400000 : 0);
+  bool cube = image.faces == 6;
+  if (cube) {
+    header.caps |= 0x8;
+    header.caps2 = DDS_CAPS2_CUBEMAP_ALL;
+  }
+  DDSHeaderDX10 dx10 = {dxgiFormat(image.codec, image.srgb, image.channels),
+                        3, cube ? DDS_MISC_TEXTURECUBE : 0, 1, 0};
+
+  // a temporary file first, like the mesh cache, so a crash never leaves a
+  // truncated file behind. One per write: a dropped load may still be
+  // writing the same cache file as the one that replaced it.
+  static atomic<unsigned> writes{0};
+  string tmpPath = path + '.' + to_string(writes++) + ".tmp";
+  ofstream out(tmpPath, ios::binary | ios::trunc);
+  if (!out) {
+    cout << "::Warning:: Cannot write texture cache: " << path << endl;
+    return false;
+  }
+  out.write(reinterpret_cast<const char *>(&DDS_MAGIC), sizeof(DDS_MAGIC));
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(&dx10), sizeof(dx10));
+  out.write(reinterpret_cast<const char *>(image.bytes()), image.byteSize());
+  out.close();
+  std::error_code ec;
+  if (!out) {
+    cout << "::Warning:: Failed writing texture cache: " << path << endl;
+    filesystem::remove(tmpPath, ec);
+    return false;
+  }
+  filesystem::rename(tmpPath, path, ec);
+  if (ec) {
+    cout << "::Warning:: Cannot replace texture cache: " << path << endl;
+    filesystem::remove(tmpPath, ec);
+    return false;
+  }
+  return true;
+}
+
+void uploadTextureLevel(GLenum target, const TextureImage &image, int level,
+                        const void *pixels) {
+  static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+  const unsigned char *base = static_cast<const unsigned char *>(pixels);
+  const TextureLevel &info = image.levels[level];
+  // rows of 1 and 3 channel images are not 4-byte aligned in general
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (image.codec == CODEC_NONE)
+    glTexImage2D(target, level, image.internalFormat(), info.width,
+                 info.height, 0, formats[image.channels - 1],
+                 GL_UNSIGNED_BYTE, base + info.offset);
+  else
+    glCompressedTexImage2D(target, level, image.internalFormat(), info.width,
+                           info.height, 0, info.size, base + info.offset);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void uploadTextureLevels(GLenum target, const TextureImage &image,
+                         const void *pixels) {
+  for (size_t i = 0; i < image.levels.size(); i++)
+    uploadTextureLevel(target, image, i, pixels);
+}
+
+void uploadTextureImage(unsigned int textureID, const TextureImage &image,
+                        const void *pixels) {
+  glBindTexture(GL_TEXTURE_2D, textureID);
+  uploadTextureLevels(GL_TEXTURE_2D, image, pixels);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                  image.levels.size() - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
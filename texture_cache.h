@@ -0,0 +1,105 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include "config.h"
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// what a texture is stored as on the GPU
+enum TextureCodec {
+  CODEC_NONE, // 8-bit pixels as decoded
+  CODEC_BC1,  // opaque colour, 4 bits per texel
+  CODEC_BC3,  // colour with alpha, 8 bits per texel
+  CODEC_BC4,  // one channel, 4 bits per texel
+  CODEC_BC5   // two channels (normal map xy), 8 bits per texel
+};
+
+struct TextureLevel {
+  int width, height;
+  size_t offset, size; // bytes into a face of TextureImage::bytes()
+};
+
+// An image ready for upload: 8-bit pixels or BCn blocks, with all of its
+// mip levels back to back in data. Cube maps hold six faces, one after the
+// other, each with its full chain.
+struct TextureImage {
+  int width = 0, height = 0;
+  int channels = 0; // of the pixels, or of the source for compressed images
+  bool srgb = false;
+  TextureCodec codec = CODEC_NONE;
+  int faces = 1;
+  vector<TextureLevel> levels;
+  vector<unsigned char> data;
+  // images read from the cache keep their levels in the mapped file
+  // instead of copying them into data
+  shared_ptr<MappedFile> file;
+  const unsigned char *mapped = nullptr;
+
+  const unsigned char *bytes() const { return file ? mapped : data.data(); }
+  size_t faceBytes() const {
+    return levels.empty() ? 0 : levels.back().offset + levels.back().size;
+  }
+  size_t byteSize() const { return faceBytes() * faces; }
+  GLenum internalFormat() const;
+  // GPU bytes of all levels, counting RGB as RGBA
+  size_t gpuBytes() const;
+  // what the image would take uploaded uncompressed with full mipmaps
+  size_t uncompressedBytes() const;
+};
+
+const char *textureCodecName(TextureCodec codec);
+
+// true if the context can sample BC1/BC3 (S3TC). BC4/BC5 are core. GL
+// thread only.
+bool textureCompressionS3TC();
+
+// Builds the full mip chain of decoded pixels (1 to 4 channels) and stores
+// it as codec; uncompressed RGB is padded to RGBA. Levels are box filtered
+// in linear space for sRGB sources, and normal maps are renormalized.
+// Filtering and block encoding run on the worker pool.
+void buildTextureImage(const unsigned char *pixels, int width, int height,
+                       int channels, TextureCodec codec, bool srgb,
+                       bool normalMap, TextureImage &image);
+
+// hash of the bytes of a source image, 0 if it can't be read. Also what the
+// texture registry tells identical files apart by.
+uint64_t textureSourceHash(const string &sourcePath);
+// key of a source image: its hash and whatever decides how it is stored
+// (salt), so changes to either invalidate the cache. 0 for a 0 hash.
+uint64_t textureCacheKey(uint64_t sourceHash, uint32_t salt);
+
+// one file per salt, so a source loaded as both colour and data keeps both
+inline string textureCachePath(const string &sourcePath, uint32_t salt) {
+  return sourcePath + '.' + to_string(salt) + TEXTURE_CACHE_EXTENSION;
+}
+
+// The cache is a DDS file with a DX10 header, so the usual tools can open
+// it; the key is kept in the header's reserved words. Cube maps are stored
+// as DDS cube maps. Reading maps the file and returns false for a missing,
+// stale or broken one.
+bool readTextureCache(const string &path, uint64_t key, TextureImage &image);
+bool writeTextureCache(const string &path, uint64_t key,
+                       const TextureImage &image);
+
+// uploads every level of image to target of the bound texture, a 2D
+// texture or one cube map face. pixels is image.bytes() (of the face) or,
+// with a bound GL_PIXEL_UNPACK_BUFFER, the offset of a copy of it.
+void uploadTextureLevels(GLenum target, const TextureImage &image,
+                         const void *pixels);
+// the same for a single level
+void uploadTextureLevel(GLenum target, const TextureImage &image, int level,
+                        const void *pixels);
+// uploads image into the 2D texture textureID and sets its sampling
+// parameters
+void uploadTextureImage(unsigned int textureID, const TextureImage &image,
+                        const void *pixels);
+
+#endif
@@ -0,0 +1,227 @@
+#include "texture_loader.h"
+#include "threadpool.h"
+#include "texture_registry.h"
+#include "texture_streamer.h"
+#include "image_decode.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+TextureLoader textureLoader;
+
+static void setPlaceholder(unsigned int textureID, TextureRole role) {
+  // neutral values: mid grey albedo, a flat tangent-space normal, and zero
+  // for specular/height data so nothing shines or shifts before it arrives
+  static const unsigned char colors[3][4] = {
+      {128, 128, 128, 255}, {128, 128, 255, 255}, {0, 0, 0, 255}};
+  glBindTexture(GL_TEXTURE_2D, textureID);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               colors[role]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+TextureCodec chooseTextureCodec(TextureRole role, int channels,
+                                const unsigned char *pixels, size_t texels,
+                                bool s3tc) {
+  if (!TEXTURE_COMPRESSION)
+    return CODEC_NONE;
+  if (channels == 1)
+    return CODEC_BC4;
+  // normal maps only need x and y, the shaders rebuild z
+  if (channels == 2 || role == TEXTURE_NORMAL)
+    return CODEC_BC5;
+  if (!s3tc)
+    return CODEC_NONE;
+  if (channels == 4)
+    for (size_t i = 0; i < texels; i++)
+      if (pixels[i * 4 + 3] != 255)
+        return CODEC_BC3;
+  return CODEC_BC1;
+}
+
+bool loadTextureImage(const string &filename, bool gamma, TextureRole role,
+                      bool s3tc, TextureImage &image, uint64_t sourceHash) {
+  uint32_t salt = textureCacheSalt(role, gamma, s3tc);
+  string cachePath = textureCachePath(filename, salt);
+  if (!sourceHash)
+    sourceHash = textureSourceHash(filename);
+  uint64_t key = textureCacheKey(sourceHash, salt);
+  if (key && readTextureCache(cachePath, key, image))
+    return true;
+
+  DecodedImage decoded;
+  if (!decodeImage(filename, decoded))
+    return false;
+  const unsigned char *pixels = decoded.pixels.get();
+  int width = decoded.width, height = decoded.height;
+  TextureCodec codec = chooseTextureCodec(role, decoded.channels, pixels,
+                                          size_t(width) * height, s3tc);
+  auto start = chrono::steady_clock::now();
+  buildTextureImage(pixels, width, height, decoded.channels, codec, gamma,
+                    role == TEXTURE_NORMAL, image);
+  cout << "Texture cached: " << filename << " (" << textureCodecName(codec)
+       << ", " << image.levels.size() << " levels, "
+       << image.uncompressedBytes() / 1048576.0 << " -> "
+       << image.gpuBytes() / 1048576.0 << " MB, "
+       << elapsedMs(start, chrono::steady_clock::now()) << " ms)" << endl;
+  if (key)
+    writeTextureCache(cachePath, key, image);
+  return true;
+}
+
+// uploads image (data at pixels, see uploadTextureImage) and reports the
+// texture's GPU size to the texture registry
+static void uploadImage(unsigned int textureID, const TextureImage &image,
+                        const void *pixels) {
+  uploadTextureImage(textureID, image, pixels);
+  textureRegistry.onUploaded(textureID, image.width, image.height,
+                             image.gpuBytes(), image.uncompressedBytes());
+}
+
+unsigned int TextureFromFile(const char *path, const string &directory,
+                             bool gamma, TextureRole role, bool streamed,
+                             uint64_t sourceHash) {
+  string filename = string(path);
+  if (directory != "")
+    filename = directory + '/' + filename;
+
+  if (ASYNC_TEXTURE_LOADING)
+    return textureLoader.request(filename, gamma, role, streamed, sourceHash);
+
+  unsigned int textureID;
+  glGenTextures(1, &textureID);
+
+  TextureImage image;
+  bool s3tc = textureCompressionS3TC();
+  // hashed here so the streamer can reuse it for every later read
+  if (!sourceHash)
+    sourceHash = textureSourceHash(filename);
+  if (loadTextureImage(filename, gamma, role, s3tc, image, sourceHash)) {
+    if (streamed)
+      textureStreamer.add(textureID, filename, gamma, role, s3tc, image,
+                          sourceHash);
+    else
+      uploadImage(textureID, image, image.bytes());
+  } else {
+    std::cout << "Texture failed to load at path: " << path << std::endl;
+    setPlaceholder(textureID, role);
+  }
+
+  return textureID;
+}
+
+unsigned int TextureLoader::request(const string &filename, bool gamma,
+                                    TextureRole role, bool streamed,
+                                    uint64_t sourceHash) {
+  unsigned int textureID;
+  glGenTextures(1, &textureID);
+  setPlaceholder(textureID, role);
+
+  auto job = make_shared<Job>();
+  job->id = textureID;
+  job->filename = filename;
+  job->gamma = gamma;
+  job->role = role;
+  job->s3tc = textureCompressionS3TC();
+  job->streamed = streamed;
+  job->sourceHash = sourceHash;
+  inFlight++;
+  queued[textureID] = job;
+  getWorkerPool().submit([this, job] {
+    if (!job->cancelled) {
+      if (!job->sourceHash)
+        job->sourceHash = textureSourceHash(job->filename);
+      job->loaded = loadTextureImage(job->filename, job->gamma, job->role,
+                                     job->s3tc, job->image, job->sourceHash);
+    }
+    lock_guard<mutex> lock(readyMutex);
+    ready.push_back(job);
+  });
+  return textureID;
+}
+
+void TextureLoader::upload(Job &job) {
+  if (!job.loaded) {
+    std::cout << "Texture failed to load at path: " << job.filename
+              << std::endl;
+    return;
+  }
+  // the streamer only uploads the small levels, straight from memory
+  if (job.streamed) {
+    textureStreamer.add(job.id, job.filename, job.gamma, job.role, job.s3tc,
+                        job.image, job.sourceHash);
+    job.image = TextureImage();
+    return;
+  }
+  if (!pbo[0])
+    glGenBuffers(PBO_COUNT, pbo);
+
+  // orphan the next buffer of the ring so that the copy never waits for a
+  // transfer the driver may still be doing from its previous contents
+  size_t size = job.image.byteSize();
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[nextPbo]);
+  nextPbo = (nextPbo + 1) % PBO_COUNT;
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+  void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                  GL_MAP_WRITE_BIT |
+                                      GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (mapped) {
+    memcpy(mapped, job.image.bytes(), size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    uploadImage(job.id, job.image, (void *)0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  } else {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    uploadImage(job.id, job.image, job.image.bytes());
+  }
+  job.image = TextureImage();
+}
+
+void TextureLoader::update(size_t budgetBytes) {
+  size_t uploaded = 0;
+  while (uploaded < budgetBytes) {
+    shared_ptr<Job> job;
+    {
+      lock_guard<mutex> lock(readyMutex);
+      if (ready.empty())
+        break;
+      job = ready.front();
+      ready.pop_front();
+    }
+    auto it = queued.find(job->id);
+    if (it != queued.end() && it->second == job)
+      queued.erase(it);
+    inFlight--;
+    if (job->cancelled)
+      continue;
+    uploaded += job->image.byteSize();
+    upload(*job);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureLoader::cancel(unsigned int id) {
+  // the id is free once the texture is deleted, and a new request may take
+  // it over before the cancelled job comes back
+  auto it = queued.find(id);
+  if (it != queued.end()) {
+    it->second->cancelled = true;
+    queued.erase(it);
+  }
+}
+
+void TextureLoader::finish() {
+  while (pending()) {
+    update(SIZE_MAX);
+    this_thread::yield();
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include "config.h"
+#include "texture_cache.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+using namespace std;
+
+// What a texture holds. Decides the 1x1 placeholder shown until the real
+// pixels have been uploaded.
+enum TextureRole { TEXTURE_COLOR, TEXTURE_NORMAL, TEXTURE_DATA };
+
+// which codec a decoded image is stored as, CODEC_NONE to keep its pixels
+TextureCodec chooseTextureCodec(TextureRole role, int channels,
+                                const unsigned char *pixels, size_t texels,
+                                bool s3tc);
+
+// everything besides the source bytes that decides how a texture is cached
+inline uint32_t textureCacheSalt(TextureRole role, bool gamma, bool s3tc) {
+  return role | gamma << 4 | s3tc << 5 | TEXTURE_COMPRESSION << 6;
+}
+
+// Reads an image with its mip chain from the texture cache file next to it,
+// or decodes it and builds the chain and the cache file. With
+// TEXTURE_COMPRESSION the levels are block compressed (colour BC1/BC3,
+// normal maps BC5). s3tc comes from textureCompressionS3TC(), the rest is
+// safe on workers. sourceHash is the file's textureSourceHash if the caller
+// has it already, 0 to hash it here.
+bool loadTextureImage(const string &filename, bool gamma, TextureRole role,
+                      bool s3tc, TextureImage &image,
+                      uint64_t sourceHash = 0);
+
+// loads an image file into a new 2D texture, see loadTextureImage. With
+// ASYNC_TEXTURE_LOADING the returned id is a placeholder that
+// TextureLoader::update() fills in later. A streamed texture is handed to
+// the texture streamer, which uploads its levels as they are needed.
+unsigned int TextureFromFile(const char *path, const string &directory,
+                             bool gamma = false,
+                             TextureRole role = TEXTURE_COLOR,
+                             bool streamed = false, uint64_t sourceHash = 0);
+
+// Decodes (or reads from the texture cache) images on the worker pool and
+// streams them into their textures
+// through pixel unpack buffers, limited to a byte budget per frame.
+class TextureLoader {
+public:
+
+  // creates the texture with a placeholder and queues the decode
+  unsigned int request(const string &filename, bool gamma, TextureRole role,
+                       bool streamed = false, uint64_t sourceHash = 0);
+
+  // uploads decoded images until budgetBytes have been sent (at least one
+  // per call). GL thread only, once per frame.
+  void update(size_t budgetBytes = TEXTURE_UPLOAD_BUDGET_MB << 20);
+  // uploads everything, waiting for outstanding decodes
+  void finish();
+  // drops a queued texture that is being deleted before it arrived
+  void cancel(unsigned int id);
+
+  // textures requested but not uploaded yet
+  unsigned int pending() const { return inFlight.load(); }
+
+private:
+  struct Job {
+    unsigned int id;
+    string filename;
+    bool gamma;
+    TextureRole role;
+    bool s3tc; // BC1/BC3 usable, checked on the GL thread
+    bool streamed;
+    uint64_t sourceHash; // set by the worker if the caller passed 0
+    bool loaded = false;
+    TextureImage image;
+    atomic<bool> cancelled{false};
+  };
+
+  mutable mutex readyMutex;
+  deque<shared_ptr<Job>> ready;
+  unordered_map<unsigned int, shared_ptr<Job>> queued; // GL thread only
+  atomic<unsigned int> inFlight{0};
+
+  static const int PBO_COUNT = 4;
+  unsigned int pbo[PBO_COUNT] = {};
+  int nextPbo = 0;
+
+  void upload(Job &job);
+};
+
+extern TextureLoader textureLoader;
+
+#endif
@@ -0,0 +1,138 @@
+#include "texture_registry.h"
+#include "texture_streamer.h"
+
+#include <filesystem>
+#include <iostream>
+using namespace std;
+
+TextureRegistry textureRegistry;
+
+static string canonicalPath(const string &filename) {
+  std::error_code ec;
+  filesystem::path path =
+      filesystem::weakly_canonical(filesystem::absolute(filename, ec), ec);
+  if (ec)
+    return filename;
+  return path.generic_string();
+}
+
+unsigned int TextureRegistry::acquire(const string &path,
+                                      const string &directory, bool gamma,
+                                      TextureRole role, bool streamed,
+                                      uint64_t sourceHash) {
+  string filename = path;
+  if (directory != "")
+    filename = directory + '/' + filename;
+  string canonical = canonicalPath(filename);
+  string space = gamma ? "|srgb" : "|linear";
+  string pathKey = canonical + space;
+
+  auto known = contentByPath.find(pathKey);
+  if (known != contentByPath.end()) {
+    Entry &entry = byKey[known->second];
+    entry.refCount++;
+    return entry.id;
+  }
+
+  // without a hash (or for a file that can't be read) the path is the key
+  string key = sourceHash ? "content:" + to_string(sourceHash) + space
+                          : "path:" + pathKey;
+  contentByPath[pathKey] = key;
+  auto it = byKey.find(key);
+  if (it != byKey.end()) {
+    Entry &entry = it->second;
+    entry.refCount++;
+    entry.pathKeys.push_back(pathKey);
+    cout << "Texture deduplicated: \n";
+    cout << "  Path: " + canonical << "\n  Same content as: " << entry.path;
+    // otherwise reported once the shared texture is uploaded
+    if (entry.bytes)
+      cout << " (" << entry.bytes / 1048576.0 << " MB saved)";
+    cout << endl;
+    return entry.id;
+  }
+
+  Entry entry;
+  entry.id = TextureFromFile(filename.c_str(), "", gamma, role, streamed,
+                             sourceHash);
+  entry.path = canonical;
+  entry.pathKeys.push_back(pathKey);
+  entry.srgb = gamma;
+  entry.refCount = 1;
+  byKey.emplace(key, entry);
+  keyById[entry.id] = key;
+  cout << "Texture has been loaded: \n";
+  cout << "  Path: " + canonical << (gamma ? " (sRGB)" : "") << endl;
+  return entry.id;
+}
+
+void TextureRegistry::release(unsigned int id) {
+  auto keyIt = keyById.find(id);
+  if (keyIt == keyById.end()) {
+    cout << "::Warning:: Releasing a texture that is not registered: " << id
+         << endl;
+    return;
+  }
+  auto it = byKey.find(keyIt->second);
+  if (--it->second.refCount > 0)
+    return;
+  textureLoader.cancel(id);
+  textureStreamer.remove(id);
+  glDeleteTextures(1, &id);
+  for (auto &pathKey : it->second.pathKeys)
+    contentByPath.erase(pathKey);
+  byKey.erase(it);
+  keyById.erase(keyIt);
+}
+
+void TextureRegistry::onUploaded(unsigned int id, int width, int height,
+                                 size_t bytes, size_t uncompressedBytes) {
+  auto keyIt = keyById.find(id);
+  if (keyIt == keyById.end())
+    return; // not a registry texture
+  Entry &entry = byKey[keyIt->second];
+  if (entry.aliases() > 0 && entry.bytes == 0)
+    cout << "Texture deduplication saved "
+         << bytes * entry.aliases() / 1048576.0 << " MB: " << entry.path
+         << " (+" << entry.aliases() << " identical)" << endl;
+  entry.width = width;
+  entry.height = height;
+  entry.bytes = bytes;
+  entry.uncompressedBytes = uncompressedBytes;
+}
+
+vector<TextureRegistry::Entry> TextureRegistry::entries() const {
+  vector<Entry> result;
+  result.reserve(byKey.size());
+  for (auto &item : byKey)
+    result.push_back(item.second);
+  return result;
+}
+
+size_t TextureRegistry::totalBytes() const {
+  size_t total = 0;
+  for (auto &item : byKey)
+    total += item.second.bytes;
+  return total;
+}
+
+size_t TextureRegistry::savedBytes() const {
+  size_t total = 0;
+  for (auto &item : byKey)
+    total += item.second.uncompressedBytes - item.second.bytes;
+  return total;
+}
+
+size_t TextureRegistry::dedupedBytes() const {
+  size_t total = 0;
+  for (auto &item : byKey)
+    total += item.second.bytes * item.second.aliases();
+  return total;
+}
+
+size_t TextureRegistry::aliases() const {
+  size_t total = 0;
+  for (auto &item : byKey)
+    total += item.second.aliases();
+  return total;
+}
@@ -0,0 +1,66 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include "texture_loader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Process-wide table of file textures, shared between all models. Entries are
+// keyed by a hash of the file's bytes plus colour space when the caller has
+// one (by canonical path otherwise) and reference counted, so byte-identical
+// files under different names share one texture; the GL texture is deleted
+// when the last user releases it.
+class TextureRegistry {
+public:
+  struct Entry {
+    unsigned int id = 0;
+    string path; // canonical absolute path of the first file loaded
+    vector<string> pathKeys; // every path (and colour space) resolving here
+    bool srgb = false;
+    int refCount = 0;
+    int width = 0, height = 0;
+    size_t bytes = 0; // GPU memory incl. mipmaps, 0 until uploaded
+    size_t uncompressedBytes = 0; // the same stored uncompressed
+
+    // files that were not loaded again because they match path
+    int aliases() const { return int(pathKeys.size()) - 1; }
+  };
+
+  // returns the texture of path (relative to directory), loading it on first
+  // use. Every acquire has to be paired with a release of the returned id.
+  // Whether the texture is streamed is decided by the first acquire.
+  // sourceHash is the file's textureSourceHash, computed off the GL thread;
+  // without it the file is only shared by path.
+  unsigned int acquire(const string &path, const string &directory, bool gamma,
+                       TextureRole role, bool streamed = false,
+                       uint64_t sourceHash = 0);
+  void release(unsigned int id);
+
+  // called once the pixels of a texture are on the GPU
+  void onUploaded(unsigned int id, int width, int height, size_t bytes,
+                  size_t uncompressedBytes);
+
+  // snapshot of all live entries, for the memory report
+  vector<Entry> entries() const;
+  size_t totalBytes() const;
+  // GPU memory compression and streaming save over all entries
+  size_t savedBytes() const;
+  // GPU memory the aliased files would have taken as textures of their own
+  size_t dedupedBytes() const;
+  size_t aliases() const;
+  size_t size() const { return byKey.size(); }
+
+private:
+  unordered_map<string, Entry> byKey;          // by content
+  unordered_map<string, string> contentByPath; // path key to content key
+  unordered_map<unsigned int, string> keyById;
+};
+
+extern TextureRegistry textureRegistry;
+
+#endif
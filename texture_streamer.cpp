@@ -0,0 +1,255 @@
+#include "texture_streamer.h"
+#include "texture_registry.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+TextureStreamer textureStreamer;
+
+// frees one level of the bound texture; a 0x0 image keeps the level
+// defined but without storage
+static void freeLevel(const TextureImage &layout, int level) {
+  if (layout.codec == CODEC_NONE)
+    glTexImage2D(GL_TEXTURE_2D, level, layout.internalFormat(), 0, 0, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  else
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, layout.internalFormat(), 0,
+                           0, 0, 0, nullptr);
+}
+
+size_t TextureStreamer::levelBytes(const Entry &entry, int first, int end) {
+  size_t bytes = 0;
+  for (int i = first; i < end; i++)
+    bytes += entry.layout.levels[i].size;
+  return bytes;
+}
+
+size_t TextureStreamer::fullBytes() const {
+  size_t bytes = 0;
+  for (auto &item : entries)
+    bytes += levelBytes(item.second, 0, item.second.layout.levels.size());
+  return bytes;
+}
+
+void TextureStreamer::add(unsigned int id, const string &filename, bool gamma,
+                          TextureRole role, bool s3tc,
+                          const TextureImage &image, uint64_t sourceHash) {
+  remove(id);
+  Entry entry;
+  entry.filename = filename;
+  entry.gamma = gamma;
+  entry.role = role;
+  entry.s3tc = s3tc;
+  entry.sourceHash = sourceHash;
+  entry.layout.width = image.width;
+  entry.layout.height = image.height;
+  entry.layout.channels = image.channels;
+  entry.layout.srgb = image.srgb;
+  entry.layout.codec = image.codec;
+  entry.layout.levels = image.levels;
+  int count = image.levels.size();
+  entry.minLevel = count - 1;
+  for (int i = 0; i < count; i++)
+    if (max(image.levels[i].width, image.levels[i].height) <=
+        TEXTURE_STREAMING_MIN_SIZE) {
+      entry.minLevel = i;
+      break;
+    }
+  entry.level = entry.wanted = entry.minLevel;
+
+  glBindTexture(GL_TEXTURE_2D, id);
+  for (int i = entry.minLevel; i < count; i++)
+    uploadTextureLevel(GL_TEXTURE_2D, image, i, image.bytes());
+  // the placeholder's level 0 goes too
+  for (int i = 0; i < entry.minLevel; i++)
+    freeLevel(entry.layout, i);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.minLevel);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, count - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  size_t bytes = levelBytes(entry, entry.level, count);
+  resident += bytes;
+  textureRegistry.onUploaded(id, image.width, image.height, bytes,
+                             image.uncompressedBytes());
+  entries.emplace(id, std::move(entry));
+}
+
+void TextureStreamer::remove(unsigned int id) {
+  auto it = entries.find(id);
+  if (it == entries.end())
+    return;
+  Entry &entry = it->second;
+  resident -= levelBytes(entry, entry.level, entry.layout.levels.size());
+  auto load = queued.find(id);
+  if (load != queued.end()) {
+    load->second->cancelled = true;
+    reserved -= levelBytes(entry, load->second->level, entry.level);
+    queued.erase(load);
+  }
+  entries.erase(it);
+}
+
+void TextureStreamer::demand(unsigned int id, float pixelsPerUV) {
+  auto it = entries.find(id);
+  if (it == entries.end())
+    return;
+  Entry &entry = it->second;
+  // texels per screen pixel picks the level, as the sampler would
+  int level = entry.minLevel;
+  if (pixelsPerUV > 0.f) {
+    float texels = max(entry.layout.width, entry.layout.height);
+    level = int(floor(log2(max(texels / pixelsPerUV, 1.f))));
+    level = min(level, entry.minLevel);
+  }
+  if (entry.lastUsed != frame) {
+    entry.lastUsed = frame;
+    entry.wanted = level;
+  } else
+    entry.wanted = min(entry.wanted, level);
+}
+
+void TextureStreamer::setLevel(unsigned int id, Entry &entry, int level) {
+  glBindTexture(GL_TEXTURE_2D, id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+  for (int i = entry.level; i < level; i++)
+    freeLevel(entry.layout, i);
+  resident -= levelBytes(entry, entry.level, level);
+  entry.level = level;
+  textureRegistry.onUploaded(
+      id, entry.layout.width, entry.layout.height,
+      levelBytes(entry, level, entry.layout.levels.size()),
+      entry.layout.uncompressedBytes());
+}
+
+size_t TextureStreamer::evict(size_t bytes, unsigned int skip) {
+  vector<pair<uint64_t, unsigned int>> order;
+  for (auto &[id, entry] : entries)
+    if (id != skip && !entry.loading && entry.level < entry.minLevel)
+      order.push_back({entry.lastUsed, id});
+  sort(order.begin(), order.end());
+
+  size_t freed = 0;
+  // first the levels finer than the last demand asked for, then everything
+  // above the minimum of textures not seen this frame
+  for (int pass = 0; pass < 2 && freed < bytes; pass++)
+    for (auto &[lastUsed, id] : order) {
+      if (freed >= bytes)
+        break;
+      Entry &entry = entries[id];
+      int limit = pass == 0           ? entry.wanted
+                  : lastUsed != frame ? entry.minLevel
+                                      : entry.level;
+      int level = entry.level;
+      while (level < limit &&
+             freed + levelBytes(entry, entry.level, level) < bytes)
+        level++;
+      if (level > entry.level) {
+        freed += levelBytes(entry, entry.level, level);
+        setLevel(id, entry, level);
+      }
+    }
+  return freed;
+}
+
+void TextureStreamer::startLoad(unsigned int id, Entry &entry, int level) {
+  auto load = make_shared<Load>();
+  load->id = id;
+  load->level = level;
+  entry.loading = true;
+  reserved += levelBytes(entry, level, entry.level);
+  queued[id] = load;
+  // the cache file holds every level, it is only read again
+  getWorkerPool().submit([this, load, filename = entry.filename,
+                          gamma = entry.gamma, role = entry.role,
+                          s3tc = entry.s3tc, sourceHash = entry.sourceHash] {
+    if (!load->cancelled)
+      load->loaded = loadTextureImage(filename, gamma, role, s3tc,
+                                      load->image, sourceHash);
+    lock_guard<mutex> lock(readyMutex);
+    ready.push_back(load);
+  });
+}
+
+void TextureStreamer::update(size_t uploadBytes) {
+  vector<shared_ptr<Load>> done, later;
+  {
+    lock_guard<mutex> lock(readyMutex);
+    done.swap(ready);
+  }
+  size_t uploaded = 0;
+  for (auto &load : done) {
+    if (load->cancelled)
+      continue;
+    if (uploaded >= uploadBytes) {
+      later.push_back(load);
+      continue;
+    }
+    queued.erase(load->id);
+    Entry &entry = entries[load->id];
+    entry.loading = false;
+    size_t bytes = levelBytes(entry, load->level, entry.level);
+    reserved -= bytes;
+    const TextureImage &image = load->image;
+    if (!load->loaded || image.codec != entry.layout.codec ||
+        image.levels.size() != entry.layout.levels.size()) {
+      cout << "::Warning:: Texture streaming failed to reload: "
+           << entry.filename << endl;
+      // keeps what is resident rather than retrying every frame
+      entry.failed = true;
+      continue;
+    }
+    glBindTexture(GL_TEXTURE_2D, load->id);
+    for (int i = load->level; i < entry.level; i++)
+      uploadTextureLevel(GL_TEXTURE_2D, image, i, image.bytes());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, load->level);
+    resident += bytes;
+    uploaded += bytes;
+    entry.level = load->level;
+    textureRegistry.onUploaded(
+        load->id, entry.layout.width, entry.layout.height,
+        levelBytes(entry, entry.level, entry.layout.levels.size()),
+        entry.layout.uncompressedBytes());
+  }
+  if (!later.empty()) {
+    lock_guard<mutex> lock(readyMutex);
+    ready.insert(ready.begin(), later.begin(), later.end());
+  }
+
+  // textures seen last frame that need finer levels, largest shortfall
+  // first
+  vector<pair<int, unsigned int>> wanting;
+  for (auto &[id, entry] : entries)
+    if (entry.lastUsed == frame && entry.wanted < entry.level &&
+        !entry.loading && !entry.failed)
+      wanting.push_back({entry.level - entry.wanted, id});
+  sort(wanting.begin(), wanting.end(), greater<pair<int, unsigned int>>());
+  for (auto &[shortfall, id] : wanting) {
+    if (queued.size() >= TEXTURE_STREAMING_MAX_LOADS)
+      break;
+    Entry &entry = entries[id];
+    size_t cost = levelBytes(entry, entry.wanted, entry.level);
+    if (resident + reserved + cost > budgetBytes)
+      evict(resident + reserved + cost - budgetBytes, id);
+    // what could not be freed is made up for by loading fewer levels
+    int level = entry.wanted;
+    while (level < entry.level &&
+           resident + reserved + levelBytes(entry, level, entry.level) >
+               budgetBytes)
+      level++;
+    if (level < entry.level)
+      startLoad(id, entry, level);
+  }
+  // a lowered budget applies without waiting for new demand
+  if (resident + reserved > budgetBytes)
+    evict(resident + reserved - budgetBytes, 0);
+
+  frame++;
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
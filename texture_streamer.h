@@ -0,0 +1,99 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include "config.h"
+#include "texture_cache.h"
+#include "texture_loader.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Keeps only the mip levels of streamed textures that their size on screen
+// calls for. A texture starts with its small levels; the G-buffer pass
+// reports how many pixels each one covers per UV unit, and update() reads
+// finer levels back from the texture cache on the worker pool. Over the
+// budget the fine levels of the least recently used textures go first.
+// Textures stay the same GL objects throughout: only their base level moves
+// and the levels below it are freed.
+class TextureStreamer {
+public:
+  size_t budgetBytes = size_t(TEXTURE_STREAMING_BUDGET_MB) << 20;
+  // set around the G-buffer pass, the only one whose draws report demand
+  bool active = false;
+
+  // takes over a texture the loader has just read: uploads the levels up to
+  // TEXTURE_STREAMING_MIN_SIZE and remembers where the rest comes from.
+  // sourceHash is the textureSourceHash the image was loaded with, so later
+  // reads don't hash the file again (0 if unknown).
+  void add(unsigned int id, const string &filename, bool gamma,
+           TextureRole role, bool s3tc, const TextureImage &image,
+           uint64_t sourceHash = 0);
+  // forgets a texture that is being deleted
+  void remove(unsigned int id);
+  bool streams(unsigned int id) const { return entries.count(id) > 0; }
+
+  // the texture is sampled at pixelsPerUV screen pixels per UV unit this
+  // frame. Ignores textures it doesn't stream.
+  void demand(unsigned int id, float pixelsPerUV);
+
+  // uploads loaded levels (up to uploadBytes of them), evicts and starts
+  // loads for the demand of the last frame. GL thread, once per frame.
+  void update(size_t uploadBytes = TEXTURE_UPLOAD_BUDGET_MB << 20);
+
+  size_t size() const { return entries.size(); }
+  size_t residentBytes() const { return resident; }
+  // bytes of all levels of every streamed texture
+  size_t fullBytes() const;
+  size_t loading() const { return queued.size(); }
+
+private:
+  struct Entry {
+    string filename;
+    bool gamma;
+    TextureRole role;
+    bool s3tc;
+    uint64_t sourceHash;
+    TextureImage layout; // levels and format, no data
+    int minLevel;        // coarsest level streaming may drop to
+    int level;           // first resident level
+    int wanted;          // finest level demanded, kept until evicted
+    uint64_t lastUsed = 0; // frame of the last demand
+    bool loading = false;
+    bool failed = false; // the cache could not be read back
+  };
+  struct Load {
+    unsigned int id;
+    int level; // first level to bring in
+    bool loaded = false;
+    TextureImage image;
+    atomic<bool> cancelled{false};
+  };
+
+  unordered_map<unsigned int, Entry> entries;
+  unordered_map<unsigned int, shared_ptr<Load>> queued; // by texture
+  mutex readyMutex;
+  vector<shared_ptr<Load>> ready;
+  uint64_t frame = 1;
+  size_t resident = 0;  // bytes of the resident levels
+  size_t reserved = 0;  // bytes of levels being loaded
+
+  static size_t levelBytes(const Entry &entry, int first, int end);
+  // moves the base level of a texture, freeing the levels above it
+  void setLevel(unsigned int id, Entry &entry, int level);
+  // drops fine levels, least recently used textures first, until bytes are
+  // free or nothing else may go. skip is the texture the room is for.
+  size_t evict(size_t bytes, unsigned int skip);
+  void startLoad(unsigned int id, Entry &entry, int level);
+};
+
+extern TextureStreamer textureStreamer;
+
+#endif
@@ -0,0 +1,96 @@
+#include "threadpool.h"
+
+#include <atomic>
+#include <memory>
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned int threads) {
+  if (threads == 0) {
+    unsigned int hardware = thread::hardware_concurrency();
+    threads = hardware > 1 ? hardware - 1 : 1;
+  }
+  for (unsigned int i = 0; i < threads; i++)
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  available.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void ThreadPool::submit(function<void()> task) {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+  }
+  available.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    function<void()> task;
+    {
+      unique_lock<std::mutex> lock(mutex);
+      available.wait(lock, [&] { return stopping || !tasks.empty(); });
+      if (stopping && tasks.empty())
+        return;
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             const function<void(size_t)> &body) {
+  if (count == 0)
+    return;
+  if (count == 1) {
+    body(0);
+    return;
+  }
+
+  // helpers may start long after the loop is finished (the queue can be busy
+  // with other jobs), so the shared state is kept alive by whoever is last
+  // and the caller only waits for items, never for the helpers themselves.
+  struct State {
+    const function<void(size_t)> *body;
+    size_t count;
+    atomic<size_t> next{0};
+    atomic<size_t> done{0};
+    std::mutex mutex;
+    condition_variable finished;
+  };
+  auto state = make_shared<State>();
+  state->body = &body;
+  state->count = count;
+
+  auto work = [](State &s) {
+    size_t i;
+    while ((i = s.next.fetch_add(1)) < s.count) {
+      (*s.body)(i);
+      if (s.done.fetch_add(1) + 1 == s.count) {
+        lock_guard<std::mutex> lock(s.mutex);
+        s.finished.notify_all();
+      }
+    }
+  };
+
+  size_t helpers = min<size_t>(workers.size(), count - 1);
+  for (size_t i = 0; i < helpers; i++)
+    submit([state, work] { work(*state); });
+  work(*state);
+
+  unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock, [&] { return state->done.load() == count; });
+}
+
+ThreadPool &getWorkerPool() {
+  static ThreadPool pool;
+  return pool;
+}
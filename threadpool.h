@@ -0,0 +1,43 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A plain fixed-size worker pool. Jobs never touch GL; anything that needs the
+// context is handed back to the main thread by the caller.
+class ThreadPool {
+public:
+  // threads == 0 picks one worker per hardware thread minus the main thread
+  explicit ThreadPool(unsigned int threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void submit(std::function<void()> task);
+
+  // runs body(i) for every i in [0, count) on the workers and the calling
+  // thread, and returns once all of them are done. Safe to call from inside
+  // a job: the caller keeps pulling items itself instead of only waiting.
+  void parallelFor(size_t count, const std::function<void(size_t)> &body);
+
+  unsigned int size() const { return workers.size(); }
+
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable available;
+  bool stopping = false;
+
+  void workerLoop();
+};
+
+// process-wide pool shared by the asset loaders
+ThreadPool &getWorkerPool();
+
+#endif
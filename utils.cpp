@@ -3,6 +3,7 @@
 #include <iostream>
 #include <vector>
 #include <random>
+#include <cstring>
 using namespace std;
 
 glm::vec3 RGBColor(float R, float G, float B) {
@@ -241,4 +242,23 @@ void copyTexture2D(unsigned int source, unsigned int target) {
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
   if (blend)
     glEnable(GL_BLEND);
-}
\ No newline at end of file
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed) {
+  // FNV-1a over 64-bit words with an extra rotate so that it doesn't
+  // degenerate on long zero runs; the tail is folded in byte by byte.
+  const uint64_t prime = 0x100000001b3ull;
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  uint64_t h = seed ^ (size * prime);
+  size_t words = size / 8;
+  for (size_t i = 0; i < words; i++) {
+    uint64_t w;
+    memcpy(&w, p + i * 8, 8);
+    h = (h ^ w) * prime;
+    h ^= h >> 29;
+  }
+  for (size_t i = words * 8; i < size; i++)
+    h = (h ^ p[i]) * prime;
+  h ^= h >> 32;
+  return h;
+}
@@ -8,6 +8,9 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "config.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 
 glm::vec3 RGBColor(float R, float G, float B);
 
@@ -24,4 +27,14 @@ unsigned int gaussianBlur(unsigned int sourceTex, float sigma, float samples,
 
 void copyTexture2D(unsigned int source, unsigned int target);
 
+// milliseconds between two time points, for load-time reports
+inline double elapsedMs(std::chrono::steady_clock::time_point from,
+                        std::chrono::steady_clock::time_point to) {
+  return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// Fast non-cryptographic 64-bit hash, used to key on-disk caches.
+uint64_t hashBytes(const void *data, size_t size,
+                   uint64_t seed = 0xcbf29ce484222325ull);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,178 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// joints a skinned vertex is bound to, and the most a model can have with
+// 8-bit joint indices
+#define MAX_BONE_INFLUENCE 4
+#define MAX_SKIN_JOINTS 256
+// shader storage binding points of the skin stream and the joint matrices,
+// see gBufferShader.vs
+#define SKIN_STREAM_BINDING 0
+#define JOINT_MATRIX_BINDING 1
+// largest |uv| the compact layout stores; half floats get too coarse past it
+#define COMPACT_UV_LIMIT 4.0f
+
+// GPU vertex layouts a mesh can be uploaded with. Vertex is always kept on the
+// CPU side, the format only decides what a mesh uploads to the GPU.
+enum VertexFormat { VERTEX_FULL, VERTEX_COMPACT };
+
+struct Vertex {
+  // position
+  glm::vec3 Position;
+  // normal
+  glm::vec3 Normal;
+  // texCoords
+  glm::vec2 TexCoords;
+  // tangent
+  glm::vec3 Tangent;
+  // bitangent
+  glm::vec3 Bitangent;
+};
+
+// Skin stream of a vertex, 12 bytes. Only skinned meshes have one, uploaded
+// next to their vertices (GeometryArena) and read by the vertex shaders from
+// a storage buffer, so static meshes don't pay for bone data.
+struct SkinVertex {
+  uint8_t joints[MAX_BONE_INFLUENCE];
+  // unorm16, summing to 65535
+  uint16_t weights[MAX_BONE_INFLUENCE];
+};
+
+// Quantized layout: 28 bytes instead of the 56 of Vertex. Normal and tangent
+// are octahedral-encoded and the bitangent is rebuilt in the shader from
+// their cross product and a sign.
+struct CompactVertex {
+  glm::vec3 Position;
+  // octahedral normal, snorm16
+  int16_t Normal[2];
+  // octahedral tangent, bitangent sign, and 0 which tells the shader this is
+  // the compact layout (the full layout's tangent has an implicit w of 1)
+  int16_t Tangent[4];
+  // half float
+  uint16_t TexCoords[2];
+};
+
+// maps a unit vector onto the [-1, 1] square of an octahedron
+inline glm::vec2 octEncode(glm::vec3 n) {
+  float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+  if (sum == 0.0f)
+    return glm::vec2(0.0f);
+  n /= sum;
+  if (n.z >= 0.0f)
+    return glm::vec2(n.x, n.y);
+  return glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                   (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+inline int16_t packSnorm16(float v) {
+  return (int16_t)std::round(glm::clamp(v, -1.0f, 1.0f) * 32767.0f);
+}
+
+// converts vertices to the compact layout. Texture coordinates are shifted by
+// a whole number (invisible with GL_REPEAT) to keep them near zero; returns
+// false if they still don't fit the half float range we accept.
+inline bool packCompactVertices(const vector<Vertex> &vertices,
+                                vector<CompactVertex> &out) {
+  if (vertices.empty())
+    return false;
+  glm::vec2 lo = vertices[0].TexCoords, hi = lo;
+  for (auto &v : vertices) {
+    lo = glm::vec2(std::min(lo.x, v.TexCoords.x), std::min(lo.y, v.TexCoords.y));
+    hi = glm::vec2(std::max(hi.x, v.TexCoords.x), std::max(hi.y, v.TexCoords.y));
+  }
+  glm::vec2 shift(std::round((lo.x + hi.x) * 0.5f),
+                  std::round((lo.y + hi.y) * 0.5f));
+  if (std::max(std::fabs(lo.x - shift.x), std::fabs(hi.x - shift.x)) >
+          COMPACT_UV_LIMIT ||
+      std::max(std::fabs(lo.y - shift.y), std::fabs(hi.y - shift.y)) >
+          COMPACT_UV_LIMIT)
+    return false;
+
+  out.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); i++) {
+    const Vertex &v = vertices[i];
+    CompactVertex &c = out[i];
+    c.Position = v.Position;
+    glm::vec2 n = octEncode(v.Normal);
+    c.Normal[0] = packSnorm16(n.x);
+    c.Normal[1] = packSnorm16(n.y);
+    glm::vec2 t = octEncode(v.Tangent);
+    c.Tangent[0] = packSnorm16(t.x);
+    c.Tangent[1] = packSnorm16(t.y);
+    c.Tangent[2] =
+        glm::dot(glm::cross(v.Normal, v.Tangent), v.Bitangent) < 0.0f ? -32767
+                                                                       : 32767;
+    c.Tangent[3] = 0;
+    c.TexCoords[0] = glm::packHalf1x16(v.TexCoords.x - shift.x);
+    c.TexCoords[1] = glm::packHalf1x16(v.TexCoords.y - shift.y);
+  }
+  return true;
+}
+
+// Index type a mesh with vertexCount vertices is drawn with: 16-bit whenever
+// every index fits. Primitive restart is never enabled, so 0xFFFF is a valid
+// index as well.
+inline GLenum indexTypeFor(size_t vertexCount) {
+  return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t indexTypeSize(GLenum type) {
+  return type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// sets the attribute pointers of the bound VAO for the vertex buffer bound
+// to GL_ARRAY_BUFFER
+inline void setupVertexAttributes(VertexFormat format) {
+  if (format == VERTEX_COMPACT) {
+    // positions stay full floats, the depth passes read nothing else
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CompactVertex),
+                          (void *)offsetof(CompactVertex, Position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex),
+                          (void *)offsetof(CompactVertex, Normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE,
+                          sizeof(CompactVertex),
+                          (void *)offsetof(CompactVertex, TexCoords));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_SHORT, GL_TRUE, sizeof(CompactVertex),
+                          (void *)offsetof(CompactVertex, Tangent));
+    // no stored bitangent
+    glDisableVertexAttribArray(4);
+    return;
+  }
+  // set the vertex attribute pointers
+  // vertex Positions
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+  // vertex normals
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, Normal));
+  // vertex texture coords
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, TexCoords));
+  // vertex tangent
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, Tangent));
+  // vertex bitangent
+  glEnableVertexAttribArray(4);
+  glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, Bitangent));
+}
+
+#endif
@@ -0,0 +1,271 @@
+#include "vertexcodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEXCODEC_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+const size_t GROUP = 16;
+const size_t BLOCK = VERTEX_CODEC_BLOCK;
+
+inline uint8_t zigzag(uint8_t delta) {
+  return uint8_t((delta << 1) ^ (int8_t(delta) >> 7));
+}
+
+// payload bytes of a group per header code: 0, 2, 4 or 8 bits per value
+const size_t GROUP_BYTES[4] = {0, 4, 8, 16};
+
+// writes the header bits and payloads of one plane; count is a multiple of
+// GROUP
+void encodePlane(const uint8_t *values, size_t count, vector<uint8_t> &out) {
+  size_t groups = count / GROUP;
+  size_t header = out.size();
+  out.resize(out.size() + (groups + 3) / 4, 0);
+  for (size_t g = 0; g < groups; g++) {
+    const uint8_t *v = values + g * GROUP;
+    uint8_t bits = 0;
+    for (size_t i = 0; i < GROUP; i++)
+      bits |= v[i];
+    int code = bits == 0 ? 0 : bits < 4 ? 1 : bits < 16 ? 2 : 3;
+    out[header + g / 4] |= uint8_t(code << (g % 4 * 2));
+    // value i and i + 4 (i + 8) share a byte, which unpacks with plain
+    // shifts and masks
+    if (code == 1)
+      for (int i = 0; i < 4; i++)
+        out.push_back(
+            uint8_t(v[i] | v[i + 4] << 2 | v[i + 8] << 4 | v[i + 12] << 6));
+    else if (code == 2)
+      for (int i = 0; i < 8; i++)
+        out.push_back(uint8_t(v[i] | v[i + 8] << 4));
+    else if (code == 3)
+      out.insert(out.end(), v, v + GROUP);
+  }
+}
+
+// decodes one plane of groups * GROUP bytes. With delta the values are
+// zigzagged differences, summed up starting from last, which is updated.
+bool decodePlane(const uint8_t *&p, const uint8_t *end, size_t groups,
+                 bool delta, uint8_t &last, uint8_t *plane) {
+  size_t headerBytes = (groups + 3) / 4;
+  if (size_t(end - p) < headerBytes)
+    return false;
+  const uint8_t *header = p;
+  p += headerBytes;
+#ifdef VERTEXCODEC_SSE
+  // last stays broadcast in a register, so the only dependency between
+  // groups is one add and the broadcast of its top byte
+  __m128i carry = _mm_set1_epi8(char(last));
+#endif
+  for (size_t g = 0; g < groups; g++) {
+    int code = header[g / 4] >> (g % 4 * 2) & 3;
+    if (size_t(end - p) < GROUP_BYTES[code])
+      return false;
+#ifdef VERTEXCODEC_SSE
+    __m128i v;
+    if (code == 0)
+      v = _mm_setzero_si128();
+    else if (code == 1) {
+      int word;
+      memcpy(&word, p, 4);
+      __m128i b = _mm_cvtsi32_si128(word), mask = _mm_set1_epi8(3);
+      __m128i v0 = _mm_and_si128(b, mask),
+              v1 = _mm_and_si128(_mm_srli_epi16(b, 2), mask),
+              v2 = _mm_and_si128(_mm_srli_epi16(b, 4), mask),
+              v3 = _mm_and_si128(_mm_srli_epi16(b, 6), mask);
+      v = _mm_unpacklo_epi64(_mm_unpacklo_epi32(v0, v1),
+                             _mm_unpacklo_epi32(v2, v3));
+    } else if (code == 2) {
+      __m128i b = _mm_loadl_epi64((const __m128i *)p),
+              mask = _mm_set1_epi8(15);
+      v = _mm_unpacklo_epi64(_mm_and_si128(b, mask),
+                             _mm_and_si128(_mm_srli_epi16(b, 4), mask));
+    } else
+      v = _mm_loadu_si128((const __m128i *)p);
+    if (delta) {
+      // unzigzag, then a prefix sum over the 16 bytes on top of last
+      __m128i sign = _mm_sub_epi8(_mm_setzero_si128(),
+                                  _mm_and_si128(v, _mm_set1_epi8(1)));
+      v = _mm_xor_si128(
+          _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x7f)), sign);
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+      v = _mm_add_epi8(v, carry);
+      carry = _mm_unpackhi_epi8(v, v);
+      carry = _mm_shufflehi_epi16(carry, 0xff);
+      carry = _mm_unpackhi_epi64(carry, carry);
+    }
+    _mm_storeu_si128((__m128i *)(plane + g * GROUP), v);
+#else
+    uint8_t *v = plane + g * GROUP;
+    for (int i = 0; i < 16; i++)
+      v[i] = code == 0   ? 0
+             : code == 1 ? p[i % 4] >> (i / 4 * 2) & 3
+             : code == 2 ? p[i % 8] >> (i / 8 * 4) & 15
+                         : p[i];
+    if (delta)
+      for (int i = 0; i < 16; i++)
+        v[i] = last = uint8_t(last + ((v[i] >> 1) ^ -(v[i] & 1)));
+#endif
+    p += GROUP_BYTES[code];
+  }
+#ifdef VERTEXCODEC_SSE
+  last = uint8_t(_mm_cvtsi128_si32(carry));
+#endif
+  return true;
+}
+
+#ifdef VERTEXCODEC_SSE
+// 16 planes of 16 elements (plane j at planes + j * BLOCK) to 16 rows of 16
+// bytes, row i going to out + i * stride
+void transpose16(const uint8_t *planes, uint8_t *out, size_t stride) {
+  __m128i a[16], b[16];
+  for (int j = 0; j < 16; j++)
+    a[j] = _mm_loadu_si128((const __m128i *)(planes + j * BLOCK));
+  // pairs, then quads, then 8 planes of ever fewer elements per register
+  for (int j = 0; j < 8; j++) {
+    b[j] = _mm_unpacklo_epi8(a[2 * j], a[2 * j + 1]);
+    b[j + 8] = _mm_unpackhi_epi8(a[2 * j], a[2 * j + 1]);
+  }
+  for (int h = 0; h < 16; h += 8)
+    for (int j = 0; j < 4; j++) {
+      a[h + j] = _mm_unpacklo_epi16(b[h + 2 * j], b[h + 2 * j + 1]);
+      a[h + 4 + j] = _mm_unpackhi_epi16(b[h + 2 * j], b[h + 2 * j + 1]);
+    }
+  for (int q = 0; q < 16; q += 4)
+    for (int j = 0; j < 2; j++) {
+      b[q + j] = _mm_unpacklo_epi32(a[q + 2 * j], a[q + 2 * j + 1]);
+      b[q + 2 + j] = _mm_unpackhi_epi32(a[q + 2 * j], a[q + 2 * j + 1]);
+    }
+  for (int q = 0; q < 16; q += 2) {
+    _mm_storeu_si128((__m128i *)(out + q * stride),
+                     _mm_unpacklo_epi64(b[q], b[q + 1]));
+    _mm_storeu_si128((__m128i *)(out + (q + 1) * stride),
+                     _mm_unpackhi_epi64(b[q], b[q + 1]));
+  }
+}
+
+// the same for 4 planes, to rows of 4 bytes
+void transpose4(const uint8_t *planes, uint8_t *out, size_t stride) {
+  __m128i p0 = _mm_loadu_si128((const __m128i *)planes),
+          p1 = _mm_loadu_si128((const __m128i *)(planes + BLOCK)),
+          p2 = _mm_loadu_si128((const __m128i *)(planes + 2 * BLOCK)),
+          p3 = _mm_loadu_si128((const __m128i *)(planes + 3 * BLOCK));
+  __m128i t0 = _mm_unpacklo_epi8(p0, p1), t1 = _mm_unpackhi_epi8(p0, p1),
+          t2 = _mm_unpacklo_epi8(p2, p3), t3 = _mm_unpackhi_epi8(p2, p3);
+  __m128i rows[4] = {_mm_unpacklo_epi16(t0, t2), _mm_unpackhi_epi16(t0, t2),
+                     _mm_unpacklo_epi16(t1, t3), _mm_unpackhi_epi16(t1, t3)};
+  for (int r = 0; r < 4; r++)
+    for (int i = 0; i < 4; i++) {
+      int word = _mm_cvtsi128_si32(rows[r]);
+      memcpy(out + (r * 4 + i) * stride, &word, 4);
+      rows[r] = _mm_srli_si128(rows[r], 4);
+    }
+}
+#endif
+
+// writes count elements back from their byte planes, plane k starting at
+// planes + k * BLOCK
+void interleave(const uint8_t *planes, size_t count, size_t stride,
+                uint8_t *out) {
+  size_t first = 0;
+#ifdef VERTEXCODEC_SSE
+  for (; first + GROUP <= count; first += GROUP) {
+    uint8_t *dst = out + first * stride;
+    size_t k = 0;
+    for (; k + 16 <= stride; k += 16)
+      transpose16(planes + k * BLOCK + first, dst + k, stride);
+    for (; k + 4 <= stride; k += 4)
+      transpose4(planes + k * BLOCK + first, dst + k, stride);
+    for (; k < stride; k++)
+      for (size_t i = 0; i < GROUP; i++)
+        dst[i * stride + k] = planes[k * BLOCK + first + i];
+  }
+#endif
+  for (size_t i = first; i < count; i++)
+    for (size_t k = 0; k < stride; k++)
+      out[i * stride + k] = planes[k * BLOCK + i];
+}
+
+void encodeElements(const uint8_t *elements, size_t count, size_t stride,
+                    bool delta, vector<uint8_t> &out) {
+  vector<uint8_t> last(stride, 0);
+  uint8_t plane[BLOCK];
+  for (size_t first = 0; first < count; first += BLOCK) {
+    size_t n = min(BLOCK, count - first);
+    size_t padded = (n + GROUP - 1) / GROUP * GROUP;
+    for (size_t k = 0; k < stride; k++) {
+      for (size_t i = 0; i < n; i++) {
+        uint8_t b = elements[(first + i) * stride + k];
+        plane[i] = delta ? zigzag(uint8_t(b - last[k])) : b;
+        last[k] = b;
+      }
+      // zero deltas, so the padding repeats the last value
+      fill(plane + n, plane + padded, 0);
+      encodePlane(plane, padded, out);
+    }
+  }
+}
+
+bool decodeElements(uint8_t *elements, size_t count, size_t stride,
+                    bool delta, const uint8_t *data, size_t size) {
+  const uint8_t *p = data, *end = data + size;
+  vector<uint8_t> last(stride, 0), planes(stride * BLOCK);
+  for (size_t first = 0; first < count; first += BLOCK) {
+    size_t n = min(BLOCK, count - first);
+    for (size_t k = 0; k < stride; k++)
+      if (!decodePlane(p, end, (n + GROUP - 1) / GROUP, delta, last[k],
+                       &planes[k * BLOCK]))
+        return false;
+    interleave(planes.data(), n, stride, elements + first * stride);
+  }
+  return true;
+}
+} // namespace
+
+void encodeVertexBuffer(const void *elements, size_t count, size_t stride,
+                        vector<uint8_t> &out) {
+  encodeElements(static_cast<const uint8_t *>(elements), count, stride, true,
+                 out);
+}
+
+bool decodeVertexBuffer(void *elements, size_t count, size_t stride,
+                        const uint8_t *data, size_t size) {
+  return decodeElements(static_cast<uint8_t *>(elements), count, stride, true,
+                        data, size);
+}
+
+// triangle lists after vertex cache optimization mostly step by a few
+// vertices, so the zigzagged differences keep their upper bytes at zero
+void encodeIndexBuffer(const unsigned int *indices, size_t count,
+                       vector<uint8_t> &out) {
+  vector<uint32_t> deltas(count);
+  uint32_t previous = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t delta = indices[i] - previous;
+    deltas[i] = delta << 1 ^ uint32_t(int32_t(delta) >> 31);
+    previous = indices[i];
+  }
+  encodeElements(reinterpret_cast<const uint8_t *>(deltas.data()), count,
+                 sizeof(uint32_t), false, out);
+}
+
+bool decodeIndexBuffer(unsigned int *indices, size_t count,
+                       const uint8_t *data, size_t size) {
+  if (!decodeElements(reinterpret_cast<uint8_t *>(indices), count,
+                      sizeof(unsigned int), false, data, size))
+    return false;
+  uint32_t previous = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t z = indices[i];
+    previous += z >> 1 ^ (0u - (z & 1));
+    indices[i] = previous;
+  }
+  return true;
+}
@@ -0,0 +1,35 @@
+#ifndef VERTEXCODEC_H
+#define VERTEXCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// Lossless codec for the vertex and index arrays of the mesh cache, built to
+// decode faster than the disk reads it saves.
+//
+// Vertices are cut into blocks of VERTEX_CODEC_BLOCK. Within a block every
+// byte of the vertex is stored as its own plane: the difference to the same
+// byte of the previous vertex, zigzagged, in groups of 16 packed to 0, 2, 4
+// or 8 bits. Neighbouring vertices mostly share the high bytes of their
+// floats, so many planes shrink to a few header bits. Indices are delta
+// coded against the previous index first and then stored the same way as
+// 4-byte elements. Decoding unpacks, undoes the deltas and transposes the
+// planes back 16 elements at a time with SSE2 where available.
+#define VERTEX_CODEC_BLOCK 256
+
+// appends the encoded elements to out. stride is the element size in bytes.
+void encodeVertexBuffer(const void *elements, size_t count, size_t stride,
+                        vector<uint8_t> &out);
+// decodes count elements from size bytes of data. Returns false if the data
+// is too short or malformed, leaving the output partly written.
+bool decodeVertexBuffer(void *elements, size_t count, size_t stride,
+                        const uint8_t *data, size_t size);
+
+void encodeIndexBuffer(const unsigned int *indices, size_t count,
+                       vector<uint8_t> &out);
+bool decodeIndexBuffer(unsigned int *indices, size_t count,
+                       const uint8_t *data, size_t size);
+
+#endif